@@ -45,15 +45,78 @@
 /* Enable use of UART in I/O streams (stdin/stdout/stderr) */
 //#define AVR_UART_UART_IOSTREAM
 
+/* printf into the TX buffer without avr-libc vfprintf */
+//#define AVR_UART_PRINTF
+
+/* Leave out the RX buffer, the RXC ISR and the receive API */
+//#define AVR_UART_TX_ONLY
+
+/* Leave out the TX buffer, the UDRE ISR and the transmit API */
+//#define AVR_UART_RX_ONLY
+
 /* Enable UART input pattern match */
 //#define AVR_UART_UART_MATCH
 
+/* Delimit SLIP/COBS frames in the RX ISR */
+//#define AVR_UART_FRAME
+
+/* Delimit lines in the RX ISR, with optional editing and echo */
+//#define AVR_UART_LINE
+
+/* Send and check binary records with a CRC trailer */
+//#define AVR_UART_RECORD
+
+/* Lock-free single-producer/single-consumer RX and TX rings */
+//#define AVR_UART_SPSC
+
+/* Keep RX/TX statistics counters */
+//#define AVR_UART_STATS
+
+/* Idle sleep while blocking calls wait for the UART ISRs */
+//#define AVR_UART_SLEEP
+
+/* Call a handler when the TX buffer drains to a low watermark */
+//#define AVR_UART_TX_WATERMARK
+
+/* RTS/CTS hardware flow control driven by RX watermarks */
+//#define AVR_UART_RTSCTS
+
+/* XON/XOFF software flow control driven by RX watermarks */
+//#define AVR_UART_XONXOFF
+
+/* Send queued RAM and flash blocks straight from the UDRE ISR */
+//#define AVR_UART_TX_DESC
+
+/* Drive an RS-485 transceiver enable pin from the TXC ISR */
+//#define AVR_UART_RS485
+
+/* Measure the baud rate of a sync byte with Timer1 */
+//#define AVR_UART_AUTOBAUD
+
+/* Receive functions with a timeout */
+//#define AVR_UART_TIMEOUT
+
 /* Use strncmp for pattern matching */
 //#define AVR_UART_STRNCMP_MATCH
 
+/* Match all patterns with one Aho-Corasick automaton */
+//#define AVR_UART_AUTOMATON_MATCH
+
+/* Allow match handlers that run in the RX ISR */
+//#define AVR_UART_ISR_MATCH
+
+/* Match patterns after the RX ISR has re-enabled interrupts */
+//#define AVR_UART_NOBLOCK_MATCH
+
 /* Emit a trigger signal that can be used by logic analyser to start capture */
 //#define AVR_UART_EMIT_TRIGGER
 
+/* Time the UART ISRs and the TX latency with Timer1 */
+//#define AVR_UART_PROFILE
+
+/* Raise a pin while each UART ISR runs */
+//#define AVR_UART_PROFILE_PINS
+
 /* SIM denotes that source code will compiled for simulation */
 //#define AVR_UART_SIMULATION
 
@@ -63,6 +126,9 @@
 /* Demo mode with serial communication program */
 //#define AVR_UART_DEMO
 
+/* Benchmark firmware and host driver */
+//#define AVR_UART_BENCHMARK
+
 /* Enable debug build with debugging information and symbols */
 //#define AVR_UART_DEBUG
 
@@ -72,4 +138,7 @@
 /* Set the compiler optimization level (-O0, -O1, -O2, -O3, -Os, etc.) */
 //#define AVR_UART_OPTIM -O2
 
+/* Link time optimization, lets the application inline library functions */
+//#define AVR_UART_LTO
+
 #endif /* _AVR_UART_CONFIG_H_ */
@@ -36,6 +36,7 @@
  * - Interrupt-driven transmission and reception
  * - Optional pattern matching callbacks
  * - Optional STDIO integration
+ * - Optional printf without avr-libc vfprintf
  */
 
 #include <stddef.h>
@@ -44,6 +45,10 @@
 #include <avr_uart_config.h>
 #include <avr_utility.h>
 #include <avr_uart_match.h>
+#include <avr_uart_frame.h>
+#include <avr_uart_line.h>
+#include <avr_uart_record.h>
+#include <avr_uart_printf.h>
 
 #ifdef AVR_UART_STDIO
 #include <stdio.h>
@@ -103,6 +108,62 @@ void avr_uart_setup();
 
 #endif /* AVR_UART_RUNTIME_CONFIG */
 
+/**
+ * @brief Get the baud rate the UART actually runs at
+ *
+ * avr_uart_setup() picks the UBRR divisor and normal or double speed (U2X)
+ * mode with the smallest error for the requested rate.
+ *
+ * @return Baud rate derived from F_CPU, UBRR and U2X
+ */
+uint32_t avr_uart_get_baud(void);
+
+/**
+ * @brief Get the error of the actual against the requested baud rate
+ *
+ * @return Error in units of 0.1 %, positive if the UART runs fast
+ *
+ * @code
+ * // 115200 baud at 16 MHz runs at 117647 baud in double speed mode
+ * int16_t e = avr_uart_get_baud_error();  // 21, +2.1 %
+ * @endcode
+ */
+int16_t avr_uart_get_baud_error(void);
+
+#ifdef AVR_UART_AUTOBAUD
+
+/**
+ * @brief Measure the baud rate of a sync byte and switch to it
+ *
+ * Disables the receiver, waits for the start bit of a 0x55 sync byte on the
+ * RXD pin and times the four falling edges after it with Timer1 at F_CPU.
+ * Edges that are not two bit times apart reject the measurement. A rate
+ * within UART_AUTOBAUD_SNAP percent of a standard rate is rounded to it,
+ * then the divisor is chosen as in avr_uart_setup() and the receiver is
+ * enabled with an empty RX buffer.
+ *
+ * @param timeout_ms Time to wait for the sync byte, 0 waits forever
+ * @return The new baud rate, 0 on timeout or a malformed sync byte with the
+ *         old baud rate kept
+ *
+ * @note Waits for the start bit with interrupts enabled and disables them
+ *       for the six bit times that are timed. An interrupt that delays
+ *       seeing the start bit by a bit time or more makes the measurement
+ *       fail.
+ * @note Timer1 is borrowed, its control registers and interrupt mask are
+ *       restored but its count and overflow flag are not
+ * @note Measures 1200 baud up to about F_CPU / 64, 250000 baud at 16 MHz.
+ *       After each timed edge about 30 cycles pass before RXD is polled
+ *       again, so a bit has to last longer than that, and the sampling
+ *       jitter of one poll of about 6 cycles has to stay within
+ *       UART_AUTOBAUD_SNAP over the span
+ */
+uint32_t avr_uart_autobaud(uint16_t timeout_ms);
+
+#endif /* AVR_UART_AUTOBAUD */
+
+#if UART_HAS_RX
+
 /**
  * @brief Flush the receive buffer
  *
@@ -111,22 +172,41 @@ void avr_uart_setup();
  */
 void avr_uart_flush_rx(void);
 
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_TX
+
 /**
  * @brief Flush the transmit buffer
  *
  * Waits for all data in the TX buffer to be transmitted before
  * clearing the buffer and resetting indices.
+ *
+ * @note With AVR_UART_RS485 it also waits until the TXC ISR has dropped the
+ *       driver enable pin after the last stop bit
+ * @note With AVR_UART_TX_DESC it also waits for the queued blocks
  */
 void avr_uart_flush_tx(void);
 
+#endif /* UART_HAS_TX */
+
 /**
  * @brief Flush both TX and RX buffers
  *
  * Combines avr_uart_flush_rx() and avr_uart_flush_tx() to clear both
  * transmit and receive buffers. Note that avr_uart_flush_tx() blocks
- * until all pending transmission is complete.
+ * until all pending transmission is complete. Single direction builds
+ * flush the buffer they have.
  */
+#if UART_HAS_RX && UART_HAS_TX
 #define avr_uart_flush() avr_uart_flush_rx(), avr_uart_flush_tx()
+#elif UART_HAS_RX
+#define avr_uart_flush() avr_uart_flush_rx()
+#else
+#define avr_uart_flush() avr_uart_flush_tx()
+#endif
+
+#if UART_HAS_RX
 
 /**
  * @brief Peek at next byte in receive buffer without removing it
@@ -152,7 +232,8 @@ char avr_uart_peek_byte(void);
  * @return The received character (0-255)
  *
  * @note This function will block indefinitely if no data is received
- * @warning Disables interrupts briefly during buffer access
+ * @warning Disables interrupts briefly during buffer access, unless
+ *          AVR_UART_SPSC is defined
  *
  * @code
  * char c = avr_uart_recv_byte();  // Blocks until data received
@@ -169,7 +250,8 @@ char avr_uart_recv_byte(void);
  * @return The received character, or 0 if buffer is empty
  *
  * @note Use this for polling-based receive patterns
- * @warning Disables interrupts briefly during buffer access
+ * @warning Disables interrupts briefly during buffer access, unless
+ *          AVR_UART_SPSC is defined
  *
  * @code
  * char c;
@@ -180,6 +262,26 @@ char avr_uart_recv_byte(void);
  */
 char avr_uart_try_recv_byte(void);
 
+/**
+ * @brief Try to receive a single byte with a separate status
+ *
+ * Unlike avr_uart_try_recv_byte() a received NUL byte can be told apart
+ * from an empty receive buffer.
+ *
+ * @param c Set to the received byte, untouched if none is available
+ * @return 1 if a byte was received, 0 if the receive buffer is empty
+ *
+ * @note Does not block
+ *
+ * @code
+ * char c;
+ * while (!avr_uart_try_recv(&c)) {
+ *     // Do other work
+ * }
+ * @endcode
+ */
+uint8_t avr_uart_try_recv(char *c);
+
 /**
  * @brief Peek multiple bytes from receive buffer without removing
  *
@@ -203,13 +305,15 @@ size_t avr_uart_peek(char* str, size_t n);
  * @brief Receive multiple bytes from UART
  *
  * Reads exactly n bytes from the receive buffer, blocking until all
- * bytes are available.
+ * bytes are available. Available bytes are copied out of the receive buffer
+ * in contiguous spans.
  *
  * @param str Buffer to store received bytes
  * @param n   Number of bytes to receive
  * @return Number of bytes actually received
  *
  * @note Blocks until n bytes are received
+ * @note The RXC interrupt is masked once per copied span, not per byte
  *
  * @code
  * char buffer[32];
@@ -218,6 +322,337 @@ size_t avr_uart_peek(char* str, size_t n);
  */
 size_t avr_uart_recv(char* str, size_t n);
 
+#ifdef AVR_UART_TIMEOUT
+
+/**
+ * @brief Peek multiple bytes, giving up after a timeout
+ *
+ * Like avr_uart_peek() but waits at most ticks for n bytes, then copies
+ * what is available.
+ *
+ * @param str   Buffer to store peeked bytes
+ * @param n     Maximum number of bytes to peek
+ * @param ticks Timeout in UART_TIMEOUT_TICKS() ticks, milliseconds without
+ *              a tick source, which run a few percent long
+ * @return Number of bytes actually peeked
+ */
+size_t avr_uart_peek_timeout(char *str, size_t n, uint16_t ticks);
+
+/**
+ * @brief Receive multiple bytes, giving up after a timeout
+ *
+ * Like avr_uart_recv() but returns once n bytes are received or ticks have
+ * passed since the call, whichever comes first.
+ *
+ * @param str   Buffer to store received bytes
+ * @param n     Number of bytes to receive
+ * @param ticks Timeout in UART_TIMEOUT_TICKS() ticks, milliseconds without
+ *              a tick source, which run a few percent long
+ * @return Number of bytes actually received, less than n on timeout
+ *
+ * @code
+ * char frame[16];
+ * if (avr_uart_recv_timeout(frame, sizeof(frame), 50) < sizeof(frame)) {
+ *     // Partial frame, resynchronise
+ * }
+ * @endcode
+ */
+size_t avr_uart_recv_timeout(char *str, size_t n, uint16_t ticks);
+
+#endif /* AVR_UART_TIMEOUT */
+
+/**
+ * @brief Expose readable bytes of the receive buffer without copying
+ *
+ * Points ptr at the oldest unread byte and sets len to the number of bytes
+ * that can be read from there without wrapping around the end of the
+ * receive buffer. The bytes stay in the buffer until avr_uart_rx_release()
+ * is called. After releasing a span that ended at the wrap point, the next
+ * call returns the bytes from the start of the buffer.
+ *
+ * @param ptr Set to the first readable byte
+ * @param len Set to the number of contiguous readable bytes, 0 if empty
+ *
+ * @note Does not block
+ * @note With UART_RX_OVERFLOW_DROP_OLDEST a full buffer may overwrite the
+ *       acquired span before it is released
+ *
+ * @code
+ * const char *p;
+ * size_t n;
+ * avr_uart_rx_acquire(&p, &n);
+ * avr_uart_rx_release(parse(p, n));  // Consume what the parser used
+ * @endcode
+ */
+void avr_uart_rx_acquire(const char **ptr, size_t *len);
+
+/**
+ * @brief Consume bytes from the receive buffer
+ *
+ * Removes n bytes at the read position, typically after working on them
+ * through avr_uart_rx_acquire().
+ *
+ * @param n Number of bytes to consume, limited to the bytes available
+ */
+void avr_uart_rx_release(size_t n);
+
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_TX
+
+/**
+ * @brief Expose free space of the transmit buffer for writing in place
+ *
+ * Points ptr at the next free byte and sets len to the number of bytes
+ * that can be written from there without wrapping around the end of the
+ * transmit buffer. Nothing is sent until avr_uart_tx_commit() is called.
+ *
+ * @param ptr Set to the first free byte
+ * @param len Set to the number of contiguous free bytes, 0 if full
+ *
+ * @note Does not block
+ *
+ * @code
+ * char *p;
+ * size_t n;
+ * avr_uart_tx_reserve(&p, &n);
+ * avr_uart_tx_commit(encode(p, n));  // Send what the encoder wrote
+ * @endcode
+ */
+void avr_uart_tx_reserve(char **ptr, size_t *len);
+
+/**
+ * @brief Queue bytes written in place for transmission
+ *
+ * @param n Number of bytes written at the pointer returned by
+ *          avr_uart_tx_reserve(), limited to the reserved length
+ */
+void avr_uart_tx_commit(size_t n);
+
+#endif /* UART_HAS_TX */
+
+#define UART_RX_ERROR_OVERFLOW     0x01
+/**< A byte was dropped because the RX buffer was full */
+#define UART_RX_ERROR_DATA_OVERRUN 0x02
+/**< The hardware receive buffer overran (DOR) */
+#define UART_RX_ERROR_FRAME        0x04
+/**< A byte was received with a frame error (FE) */
+#define UART_RX_ERROR_PARITY       0x08
+/**< A byte was received with a parity error (UPE) */
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
+
+/**
+ * @brief Read and clear the latched receive errors
+ *
+ * Errors are latched by the RX ISR and stay set until read.
+ *
+ * @return Bitwise OR of UART_RX_ERROR_* flags, 0 if no error occurred
+ *
+ * @note Only available when UART_RX_OVERFLOW_POLICY is
+ *       UART_RX_OVERFLOW_FLAG_ERROR
+ *
+ * @code
+ * if (avr_uart_rx_error() & UART_RX_ERROR_OVERFLOW) {
+ *     // Resynchronise the protocol
+ * }
+ * @endcode
+ */
+uint8_t avr_uart_rx_error(void);
+
+#endif /* UART_RX_OVERFLOW_FLAG_ERROR */
+
+#if defined AVR_UART_TX_WATERMARK || defined AVR_UART_TX_DESC
+
+/**
+ * @brief Callback function type for TX notifications
+ *
+ * Receives the data pointer passed to avr_uart_set_tx_watermark(),
+ * avr_uart_send_desc() or avr_uart_pgm_send_desc().
+ */
+typedef void (*avr_uart_tx_handler)(void *);
+
+#endif
+
+#ifdef AVR_UART_TX_WATERMARK
+
+/**
+ * @brief Get notified when space frees up in the transmit buffer
+ *
+ * The handler is called from the UDRE ISR each time the transmit buffer
+ * drains down to the point where free bytes are free, so producers wake
+ * once per watermark instead of once per byte.
+ *
+ * @param free    Number of free bytes that triggers the handler, 0 disables
+ * @param handler Callback function, NULL disables
+ * @param data    User data passed to handler
+ *
+ * @note The handler runs in ISR context and must only signal the main
+ *       loop, for example by setting a flag. It must not send, reserve or
+ *       block, the main loop is the only producer of the transmit buffer
+ *       and may be in the middle of writing to it.
+ *
+ * @code
+ * void on_tx_space(void *data) {
+ *     *(volatile uint8_t *)data = 1;
+ * }
+ *
+ * avr_uart_set_tx_watermark(16, on_tx_space, (void *)&tx_ready);
+ * @endcode
+ */
+void avr_uart_set_tx_watermark(size_t free, avr_uart_tx_handler handler,
+    void *data);
+
+#endif /* AVR_UART_TX_WATERMARK */
+
+#ifdef AVR_UART_TX_DESC
+
+/**
+ * @brief Queue a block in RAM that is sent without copying it into the ring
+ *
+ * The UDRE ISR sends the bytes queued before the block, then the block
+ * straight from data, then the bytes queued after it. Up to
+ * UART_TX_DESC_QUEUE_LEN blocks can be queued, the call never waits.
+ *
+ * @param data      Bytes to send, must stay valid until done is called
+ * @param len       Number of bytes
+ * @param done      Called once the last byte is in UDR, may be NULL
+ * @param done_data User data passed to done
+ * @return 1 if queued, 0 if the block queue or, without AVR_UART_SPSC, the
+ *         TX ring is full
+ *
+ * @note done runs in ISR context and may queue the next block, queueing from
+ *       it and from the main loop at the same time is safe. An empty block
+ *       calls done right away
+ *
+ * @code
+ * static char sample[128];
+ *
+ * void on_sent(void *data) {
+ *     *(volatile uint8_t *)data = 1;
+ * }
+ *
+ * avr_uart_send_desc(sample, sizeof(sample), on_sent, (void *)&sample_free);
+ * @endcode
+ */
+uint8_t avr_uart_send_desc(const void *data, size_t len,
+    avr_uart_tx_handler done, void *done_data);
+
+/**
+ * @brief Queue a block in flash that is sent without copying it into the ring
+ *
+ * Same as avr_uart_send_desc() with the bytes read from program memory.
+ *
+ * @code
+ * static const char banner[] PROGMEM = "...";
+ *
+ * avr_uart_pgm_send_desc(banner, sizeof(banner) - 1, NULL, NULL);
+ * @endcode
+ */
+uint8_t avr_uart_pgm_send_desc(PGM_P data, size_t len,
+    avr_uart_tx_handler done, void *done_data);
+
+#endif /* AVR_UART_TX_DESC */
+
+#ifdef AVR_UART_STATS
+
+/**
+ * @brief UART statistics counters
+ *
+ * Counters wrap around on overflow. High-water marks are the largest fill
+ * levels seen since the last reset.
+ */
+struct avr_uart_stats {
+  uint32_t rx_bytes;        /**< Bytes read from UDR by the RX ISR */
+  uint32_t tx_bytes;        /**< Bytes written to UDR by the UDRE ISR */
+  uint16_t rx_dropped;      /**< Bytes lost because the RX buffer was full */
+  uint16_t rx_data_overrun; /**< Hardware data overruns (DOR) */
+  uint16_t rx_frame_error;  /**< Hardware frame errors (FE) */
+  uint16_t rx_parity_error; /**< Hardware parity errors (UPE) */
+  uint16_t rx_match_dropped; /**< Bytes not matched, the match queue was full */
+  uint16_t rx_high_water;   /**< Highest RX buffer fill level */
+  uint16_t tx_high_water;   /**< Highest TX buffer fill level */
+};
+
+/**
+ * @brief Take a snapshot of the statistics counters
+ *
+ * @param stats Structure to copy the counters into
+ *
+ * @note This function is only available when AVR_UART_STATS is defined
+ *
+ * @code
+ * struct avr_uart_stats stats;
+ * avr_uart_get_stats(&stats);
+ * avr_uart_send_uint(stats.rx_high_water);
+ * @endcode
+ */
+void avr_uart_get_stats(struct avr_uart_stats *stats);
+
+/**
+ * @brief Reset all statistics counters and high-water marks to zero
+ *
+ * @note This function is only available when AVR_UART_STATS is defined
+ */
+void avr_uart_reset_stats(void);
+
+#endif /* AVR_UART_STATS */
+
+#ifdef AVR_UART_PROFILE
+
+/**
+ * @brief Minimum, maximum and average of a duration in CPU cycles
+ *
+ * Divide by F_CPU / 1000000 for microseconds.
+ */
+struct avr_uart_timing {
+  uint32_t min;   /**< Shortest duration */
+  uint32_t max;   /**< Longest duration */
+  uint32_t avg;   /**< Average duration */
+  uint32_t count; /**< Samples in the average, halved when its sum overflows */
+};
+
+/**
+ * @brief UART ISR profile
+ *
+ * ISR durations run from after the compiler generated prologue to before
+ * the epilogue, register saves, restores and the interrupt response are not
+ * included. The RX ISR includes avr_uart_do_match() and ISR match handlers.
+ */
+struct avr_uart_profile {
+  struct avr_uart_timing rx_isr;     /**< RX complete ISR */
+  struct avr_uart_timing udre_isr;   /**< Data register empty ISR */
+  struct avr_uart_timing tx_latency; /**< TX buffer byte enqueued to UDR */
+};
+
+/**
+ * @brief Take a snapshot of the ISR profile
+ *
+ * @param profile Structure to copy the timings into
+ *
+ * @note This function is only available when AVR_UART_PROFILE is defined
+ * @note Timer1 is set to run free at F_CPU with its overflow interrupt
+ *       enabled, the application may read but not reconfigure it
+ *
+ * @code
+ * struct avr_uart_profile p;
+ * avr_uart_get_profile(&p);
+ * avr_uart_printf("rx isr max %lu cycles\r\n", p.rx_isr.max);
+ * @endcode
+ */
+void avr_uart_get_profile(struct avr_uart_profile *profile);
+
+/**
+ * @brief Reset all timings of the ISR profile
+ *
+ * @note This function is only available when AVR_UART_PROFILE is defined
+ */
+void avr_uart_reset_profile(void);
+
+#endif /* AVR_UART_PROFILE */
+
+#if UART_HAS_TX
+
 /**
  * @brief Send a single byte via UART
  *
@@ -256,13 +691,14 @@ char avr_uart_try_send_byte(char c);
 /**
  * @brief Send multiple bytes via UART
  *
- * Transmits a string of exactly len bytes. Each byte is added to the
- * transmit buffer and sent asynchronously.
+ * Transmits a string of exactly len bytes. The bytes are copied into the
+ * transmit buffer in contiguous spans and sent asynchronously.
  *
  * @param str Pointer to data to send
  * @param len Number of bytes to send
  *
  * @note Blocks if TX buffer becomes full
+ * @note The UDRE interrupt is masked once per copied span, not per byte
  *
  * @code
  * avr_uart_send("Hello", 5);    // Send string from RAM
@@ -313,23 +749,82 @@ void avr_uart_send_uint(unsigned int u);
 void avr_uart_send_int(int n);
 
 /**
- * @brief Send a floating-point number as text
+ * @brief Send fixed width unsigned integers as decimal text
+ *
+ * Digits are found by subtracting powers of ten, without division, and the
+ * text is enqueued in one avr_uart_send().
+ *
+ * @param u Unsigned integer to send
+ *
+ * @code
+ * avr_uart_send_uint32(4000000000UL);  // Sends "4000000000"
+ * @endcode
+ */
+void avr_uart_send_uint8(uint8_t u);
+void avr_uart_send_uint16(uint16_t u);
+void avr_uart_send_uint32(uint32_t u);
+
+/**
+ * @brief Send fixed width signed integers as decimal text
+ *
+ * @param n Signed integer to send, the minimum values are handled too
+ *
+ * @code
+ * avr_uart_send_int32(-100000L);  // Sends "-100000"
+ * @endcode
+ */
+void avr_uart_send_int8(int8_t n);
+void avr_uart_send_int16(int16_t n);
+void avr_uart_send_int32(int32_t n);
+
+/**
+ * @brief Send unsigned integers as upper case hexadecimal text
+ *
+ * All digits of the type are sent, without a prefix.
+ *
+ * @param u Unsigned integer to send
+ *
+ * @code
+ * avr_uart_send_hex16(0x2a);  // Sends "002A"
+ * @endcode
+ */
+void avr_uart_send_hex8(uint8_t u);
+void avr_uart_send_hex16(uint16_t u);
+void avr_uart_send_hex32(uint32_t u);
+
+/**
+ * @brief Send a floating-point number as fixed point text
  *
- * Converts a float to its string representation with specified
- * number of decimal places and sends via UART.
+ * Sends the sign, the integer part and m rounded fractional digits,
+ * keeping leading zeros of the fraction. The text is enqueued in one
+ * avr_uart_send().
  *
  * @param f Float to send
- * @param m Number of decimal places (0-4)
+ * @param m Number of decimal places (0-9)
  *
- * @note Maximum 4 decimal places supported
- * @note Fractional part > 4 digits may not work correctly
+ * @note Magnitudes of 2^32 and above are sent as "ovf", infinities as
+ *       "inf" and NaN as "nan"
+ * @note Digits beyond the precision of float (about 7 significant digits)
+ *       are not meaningful
  *
  * @code
  * avr_uart_send_float(3.14159, 2);  // Sends "3.14"
+ * avr_uart_send_float(-0.05, 3);    // Sends "-0.050"
  * @endcode
  */
 void avr_uart_send_float(float f, uint8_t m);
 
+/**
+ * @brief Send a double as fixed point text
+ *
+ * Same as avr_uart_send_float(). With the default 32-bit double of avr-gcc
+ * both are identical, with -mdouble=64 the arithmetic is done in double.
+ *
+ * @param d Double to send
+ * @param m Number of decimal places (0-9)
+ */
+void avr_uart_send_double(double d, uint8_t m);
+
 /**
  * @brief Send a newline (CRLF)
  *
@@ -357,4 +852,6 @@ void avr_uart_newline(void);
  */
 void avr_uart_clear(void);
 
+#endif /* UART_HAS_TX */
+
 #endif /* _AVR_UART_H_ */
@@ -42,8 +42,42 @@
  * - UART_RX_BUFFER_LEN: RX buffer size (default 64)
  * - UART_MAX_SEQ_LEN: Max pattern match length (default 8)
  * - UART_MATCH_MAX: Max number of patterns (default 8)
+ * - UART_MATCH_POOL_LEN: Bytes shared by all pattern strings (default 64)
+ * - UART_MATCH_EDGE_MAX: Transitions of the compiled automaton with
+ *   AVR_UART_AUTOMATON_MATCH (default 5/4 of the pattern pool)
+ * - UART_RX_OVERFLOW_POLICY: What happens to bytes received while the RX
+ *   buffer is full (default drop newest)
+ * - UART_FRAME_ENCODING: Frame encoding of the framing layer (default SLIP)
+ * - UART_FRAME_QUEUE_LEN: Max number of complete frames queued (default 4)
+ * - UART_TX_DESC_QUEUE_LEN: Max number of TX blocks queued (default 4)
+ * - UART_LINE_QUEUE_LEN: Max number of complete lines queued (default 4)
+ * - UART_ECHO_LEN: Bytes of line echo waiting to be sent, a power of two
+ *   (default 8)
+ * - UART_RECORD_CRC: CRC of the record trailer (default CRC-16)
+ * - UART_RECORD_QUEUE_LEN: Max number of complete records queued
+ *   (default 4)
+ * - UART_MATCH_QUEUE_LEN: Max number of received bytes waiting to be
+ *   matched with AVR_UART_NOBLOCK_MATCH (default 8)
+ * - UART_TIMEOUT_TICKS: Tick source for timed receives (default 1 ms
+ *   busy delays)
+ * - UART_RS485_DE_PORT, UART_RS485_DE_DDR, UART_RS485_DE_BIT: RS-485
+ *   driver enable pin (default PD2)
+ * - UART_RX_HIGH_WATER, UART_RX_LOW_WATER: RX fill levels that stop and
+ *   restart the peer under flow control (default 3/4 and 1/4 of the buffer)
+ * - UART_RTS_*, UART_CTS_*: RTS and CTS pins (default PD4 and PD5)
+ * - UART_PROFILE_PORT, UART_PROFILE_DDR, UART_PROFILE_RX_BIT,
+ *   UART_PROFILE_UDRE_BIT: Pins high while the RX and UDRE ISRs run
+ *   (default PB0 and PB1)
+ * - UART_AUTOBAUD_SNAP: Percent a measured baud rate may be off a standard
+ *   rate to be rounded to it (default 3)
+ * - UART_BAUD_MAX_ERROR: Largest baud rate error the build accepts, in
+ *   0.1 % units (default 20)
+ * - UART_RX_MAX_LATENCY_US: Longest time the application leaves the RX
+ *   buffer unread, checked against its size (default 0, not checked)
+ * - UART_SRAM_MAX: Bytes the buffers may take (default half the SRAM)
  *
  * @note Memory-constrained devices may need smaller buffer sizes
+ * @note Buffers longer than 255 bytes use 16-bit ring counts and indices
  */
 
 #include <avr_portable.h>
@@ -69,6 +103,33 @@ typedef struct avr_uart_config {
 
 #endif /* AVR_UART_RUNTIME_CONFIG */
 
+#if defined AVR_UART_TX_ONLY && defined AVR_UART_RX_ONLY
+#error AVR_UART_TX_ONLY and AVR_UART_RX_ONLY leave nothing to build
+#endif
+
+/**
+ * @brief Whether the receive side is built
+ *
+ * AVR_UART_TX_ONLY leaves out the RX buffer, the RXC ISR and the receive API.
+ */
+#ifdef AVR_UART_TX_ONLY
+#define UART_HAS_RX 0
+#else
+#define UART_HAS_RX 1
+#endif
+
+/**
+ * @brief Whether the transmit side is built
+ *
+ * AVR_UART_RX_ONLY leaves out the TX buffer, the UDRE ISR and the transmit
+ * API.
+ */
+#ifdef AVR_UART_RX_ONLY
+#define UART_HAS_TX 0
+#else
+#define UART_HAS_TX 1
+#endif
+
 /*
  * NOTE:
  * Mind the size of the RAM when deciding Rx and Tx buffer sizes.
@@ -94,6 +155,42 @@ enum { UART_MAX_SEQ_LEN_DEFAULT = 8 };
  */
 enum { UART_MATCH_MAX_DEFAULT = 8 };
 
+/**
+ * @brief Default size of the pool holding all pattern strings
+ */
+enum { UART_MATCH_POOL_LEN_DEFAULT = 64 };
+
+/**
+ * @brief Default maximum number of complete frames awaiting avr_uart_frame_recv
+ */
+enum { UART_FRAME_QUEUE_LEN_DEFAULT = 4 };
+
+/**
+ * @brief Default maximum number of blocks queued with avr_uart_send_desc
+ */
+enum { UART_TX_DESC_QUEUE_LEN_DEFAULT = 4 };
+
+/**
+ * @brief Default maximum number of complete lines awaiting avr_uart_readline
+ */
+enum { UART_LINE_QUEUE_LEN_DEFAULT = 4 };
+
+/**
+ * @brief Default number of line echo bytes waiting for the UDRE ISR
+ */
+enum { UART_ECHO_LEN_DEFAULT = 8 };
+
+/**
+ * @brief Default maximum number of complete records awaiting
+ *        avr_uart_record_recv
+ */
+enum { UART_RECORD_QUEUE_LEN_DEFAULT = 4 };
+
+/**
+ * @brief Default maximum number of received bytes waiting to be matched
+ */
+enum { UART_MATCH_QUEUE_LEN_DEFAULT = 8 };
+
 /**
  * @brief Default UART baud rate
  */
@@ -203,4 +300,586 @@ enum { UART_STOP_BITS_DEFAULT = 1 };
 #define UART_MATCH_MAX UART_MATCH_MAX_DEFAULT
 #endif
 
+#ifndef UART_MATCH_POOL_LEN
+/**
+ * @brief UART match pattern pool size override
+ *
+ * Define this before including avr_uart_config.h to set the number of bytes
+ * shared by all registered patterns. Patterns are stored without
+ * terminators, so memory follows the actual pattern lengths. Patterns
+ * registered from flash take no pool bytes, 0 leaves only those unless
+ * AVR_UART_AUTOMATON_MATCH needs the pool length to size its trie.
+ * Default: 64
+ */
+#define UART_MATCH_POOL_LEN UART_MATCH_POOL_LEN_DEFAULT
+#endif
+
+#ifndef UART_MATCH_EDGE_MAX
+/**
+ * @brief UART match automaton edge count override
+ *
+ * Define this before including avr_uart_config.h to set the number of
+ * transitions the compiled automaton of AVR_UART_AUTOMATON_MATCH can hold,
+ * the trie edges plus those inherited from fail targets. A registration the
+ * automaton cannot hold fails.
+ * Default: UART_MATCH_POOL_LEN + UART_MATCH_POOL_LEN / 4
+ */
+#define UART_MATCH_EDGE_MAX (UART_MATCH_POOL_LEN + UART_MATCH_POOL_LEN / 4)
+#endif
+
+#define UART_RX_OVERFLOW_DROP_NEWEST 0
+/**< Discard a byte received while the RX buffer is full */
+#define UART_RX_OVERFLOW_DROP_OLDEST 1
+/**< Discard the oldest unread byte to make room for the received one */
+#define UART_RX_OVERFLOW_FLAG_ERROR  2
+/**< Discard the received byte and latch UART_RX_ERROR_OVERFLOW */
+
+#ifndef UART_RX_OVERFLOW_POLICY
+/**
+ * @brief UART RX overflow policy override
+ *
+ * Define this before including avr_uart_config.h to choose what happens to
+ * bytes received while the RX buffer is full.
+ * Options: UART_RX_OVERFLOW_DROP_NEWEST, UART_RX_OVERFLOW_DROP_OLDEST,
+ * UART_RX_OVERFLOW_FLAG_ERROR
+ * Default: UART_RX_OVERFLOW_DROP_NEWEST
+ *
+ * @note UART_RX_OVERFLOW_DROP_OLDEST cannot be used with AVR_UART_SPSC
+ */
+#define UART_RX_OVERFLOW_POLICY UART_RX_OVERFLOW_DROP_NEWEST
+#endif
+
+#define UART_FRAME_SLIP 0
+/**< RFC 1055 framing, 0xC0 delimits frames and is escaped inside them */
+#define UART_FRAME_COBS 1
+/**< Consistent overhead byte stuffing, 0x00 delimits frames */
+
+#ifndef UART_FRAME_ENCODING
+/**
+ * @brief UART frame encoding override
+ *
+ * Define this before including avr_uart_config.h to choose the encoding used
+ * by the framing layer.
+ * Options: UART_FRAME_SLIP, UART_FRAME_COBS
+ * Default: UART_FRAME_SLIP
+ */
+#define UART_FRAME_ENCODING UART_FRAME_SLIP
+#endif
+
+#define UART_RECORD_CRC16 0
+/**< CRC-16/MODBUS trailer, two bytes */
+#define UART_RECORD_CRC8  1
+/**< Maxim CRC-8 trailer, one byte */
+
+#ifndef UART_RECORD_CRC
+/**
+ * @brief UART record CRC override
+ *
+ * Define this before including avr_uart_config.h to choose the CRC that
+ * ends each record.
+ * Options: UART_RECORD_CRC16, UART_RECORD_CRC8
+ * Default: UART_RECORD_CRC16
+ */
+#define UART_RECORD_CRC UART_RECORD_CRC16
+#endif
+
+#ifndef UART_FRAME_QUEUE_LEN
+/**
+ * @brief UART frame queue length override
+ *
+ * Define this before including avr_uart_config.h to set the number of
+ * complete frames that can wait in the RX buffer.
+ * Default: 4
+ */
+#define UART_FRAME_QUEUE_LEN UART_FRAME_QUEUE_LEN_DEFAULT
+#endif
+
+#ifndef UART_TX_DESC_QUEUE_LEN
+/**
+ * @brief UART TX descriptor queue length override
+ *
+ * Define this before including avr_uart_config.h to set the number of
+ * blocks that can wait for the UDRE ISR, at most 255.
+ * Default: 4
+ */
+#define UART_TX_DESC_QUEUE_LEN UART_TX_DESC_QUEUE_LEN_DEFAULT
+#endif
+
+#ifndef UART_LINE_QUEUE_LEN
+/**
+ * @brief UART line queue length override
+ *
+ * Define this before including avr_uart_config.h to set the number of
+ * complete lines that can wait in the RX buffer.
+ * Default: 4
+ */
+#define UART_LINE_QUEUE_LEN UART_LINE_QUEUE_LEN_DEFAULT
+#endif
+
+#ifndef UART_ECHO_LEN
+/**
+ * @brief UART line echo length override
+ *
+ * Define this before including avr_uart_config.h to set how many echo bytes
+ * of UART_LINE_ECHO can wait to be sent, a power of two from 2 to 256. One
+ * byte is kept free, echo that does not fit is lost.
+ * Default: 8
+ */
+#define UART_ECHO_LEN UART_ECHO_LEN_DEFAULT
+#endif
+
+#ifndef UART_RECORD_QUEUE_LEN
+/**
+ * @brief UART record queue length override
+ *
+ * Define this before including avr_uart_config.h to set the number of
+ * complete records that can wait in the RX buffer.
+ * Default: 4
+ */
+#define UART_RECORD_QUEUE_LEN UART_RECORD_QUEUE_LEN_DEFAULT
+#endif
+
+#ifndef UART_MATCH_QUEUE_LEN
+/**
+ * @brief UART match queue length override
+ *
+ * Define this before including avr_uart_config.h to set the number of bytes
+ * that can arrive while the RX ISR matches with interrupts enabled, at most
+ * 254.
+ * Default: 8
+ */
+#define UART_MATCH_QUEUE_LEN UART_MATCH_QUEUE_LEN_DEFAULT
+#endif
+
+#ifdef UART_TIMEOUT_TICKS
+/**
+ * @def UART_TIMEOUT_TICKS
+ * @brief Tick source for the timed receive functions
+ *
+ * Define this to the name of a function `uint16_t f(void)` returning a free
+ * running tick count, such as a millisecond counter kept by a timer ISR.
+ * Timeouts are then given in its ticks and timed waits may idle sleep.
+ * Without it timed waits count busy delays of 1 ms. Those run up to 5 %
+ * long, 8 % below 2 MHz, from the checks between the delays, and longer by
+ * the time spent in interrupts.
+ */
+#endif
+
+#ifdef AVR_UART_RS485
+
+#ifndef UART_RS485_DE_PORT
+/**
+ * @brief RS-485 driver enable pin override
+ *
+ * Define UART_RS485_DE_PORT, UART_RS485_DE_DDR and UART_RS485_DE_BIT before
+ * including avr_uart_config.h to select the pin driving DE (and the
+ * inverted RE) of the transceiver. The pin is high while transmitting.
+ * Default: PD2
+ */
+#define UART_RS485_DE_PORT PORTD
+#endif
+
+#ifndef UART_RS485_DE_DDR
+#define UART_RS485_DE_DDR DDRD
+/**< Data direction register of the RS-485 driver enable pin */
+#endif
+
+#ifndef UART_RS485_DE_BIT
+#define UART_RS485_DE_BIT PD2
+/**< Bit of the RS-485 driver enable pin */
+#endif
+
+#endif /* AVR_UART_RS485 */
+
+#if defined AVR_UART_RTSCTS || defined AVR_UART_XONXOFF
+
+#ifndef UART_RX_HIGH_WATER
+/**
+ * @brief RX flow control high watermark override
+ *
+ * Define this before including avr_uart_config.h to set the RX buffer fill
+ * level at which the RX ISR stops the peer.
+ * Default: 3/4 of UART_RX_BUFFER_LEN
+ */
+#define UART_RX_HIGH_WATER (UART_RX_BUFFER_LEN * 3 / 4)
+#endif
+
+#ifndef UART_RX_LOW_WATER
+/**
+ * @brief RX flow control low watermark override
+ *
+ * Define this before including avr_uart_config.h to set the RX buffer fill
+ * level at which reads let a stopped peer go on.
+ * Default: 1/4 of UART_RX_BUFFER_LEN
+ */
+#define UART_RX_LOW_WATER (UART_RX_BUFFER_LEN / 4)
+#endif
+
+#endif /* AVR_UART_RTSCTS || AVR_UART_XONXOFF */
+
+#ifdef AVR_UART_XONXOFF
+
+#define UART_XON  0x11
+/**< DC1, lets a stopped sender go on */
+#define UART_XOFF 0x13
+/**< DC3, stops the sender */
+
+#endif /* AVR_UART_XONXOFF */
+
+#ifdef AVR_UART_RTSCTS
+
+#ifndef UART_RTS_PORT
+/**
+ * @brief RTS output pin override
+ *
+ * Define UART_RTS_PORT, UART_RTS_DDR and UART_RTS_BIT before including
+ * avr_uart_config.h to select the RTS output. RTS is low while the peer may
+ * send and high once the RX buffer reaches UART_RX_HIGH_WATER.
+ * Default: PD4
+ */
+#define UART_RTS_PORT PORTD
+#endif
+
+#ifndef UART_RTS_DDR
+#define UART_RTS_DDR DDRD
+/**< Data direction register of the RTS pin */
+#endif
+
+#ifndef UART_RTS_BIT
+#define UART_RTS_BIT PD4
+/**< Bit of the RTS pin */
+#endif
+
+#ifndef UART_CTS_PIN
+/**
+ * @brief CTS input pin override
+ *
+ * Define UART_CTS_PIN, UART_CTS_PORT, UART_CTS_DDR and UART_CTS_BIT before
+ * including avr_uart_config.h to select the CTS input, and UART_CTS_PCMSK,
+ * UART_CTS_PCINT_BIT, UART_CTS_PCIE and UART_CTS_PCINT_VECT for its pin
+ * change interrupt. Transmission pauses while CTS is high.
+ * Default: PD5 on PCINT21
+ *
+ * @note The library owns the pin change vector
+ */
+#define UART_CTS_PIN PIND
+#endif
+
+#ifndef UART_CTS_PORT
+#define UART_CTS_PORT PORTD
+/**< Port register of the CTS pin, enables its pull-up */
+#endif
+
+#ifndef UART_CTS_DDR
+#define UART_CTS_DDR DDRD
+/**< Data direction register of the CTS pin */
+#endif
+
+#ifndef UART_CTS_BIT
+#define UART_CTS_BIT PD5
+/**< Bit of the CTS pin */
+#endif
+
+#ifndef UART_CTS_PCMSK
+#define UART_CTS_PCMSK PCMSK2
+/**< Pin change mask register of the CTS pin */
+#endif
+
+#ifndef UART_CTS_PCINT_BIT
+#define UART_CTS_PCINT_BIT UART_CTS_BIT
+/**< Bit of the CTS pin in UART_CTS_PCMSK */
+#endif
+
+#ifndef UART_CTS_PCIE
+#define UART_CTS_PCIE PCIE2
+/**< Pin change interrupt enable bit of the CTS pin */
+#endif
+
+#ifndef UART_CTS_PCINT_VECT
+#define UART_CTS_PCINT_VECT PCINT2_vect
+/**< Pin change interrupt vector of the CTS pin */
+#endif
+
+#endif /* AVR_UART_RTSCTS */
+
+#ifdef AVR_UART_PROFILE_PINS
+
+#ifndef UART_PROFILE_PORT
+/**
+ * @brief ISR profiling pin override
+ *
+ * Define UART_PROFILE_PORT, UART_PROFILE_DDR, UART_PROFILE_RX_BIT and
+ * UART_PROFILE_UDRE_BIT before including avr_uart_config.h to select the
+ * pins that are high while the RX and the UDRE ISR run. The port has to be
+ * in the I/O space, single bit updates are then one instruction.
+ * Default: PB0 and PB1
+ */
+#define UART_PROFILE_PORT PORTB
+#endif
+
+#ifndef UART_PROFILE_DDR
+#define UART_PROFILE_DDR DDRB
+/**< Data direction register of the profiling pins */
+#endif
+
+#ifndef UART_PROFILE_RX_BIT
+#define UART_PROFILE_RX_BIT PB0
+/**< Bit of the pin high during the RX ISR */
+#endif
+
+#ifndef UART_PROFILE_UDRE_BIT
+#define UART_PROFILE_UDRE_BIT PB1
+/**< Bit of the pin high during the UDRE ISR */
+#endif
+
+#endif /* AVR_UART_PROFILE_PINS */
+
+#ifdef AVR_UART_AUTOBAUD
+
+#ifndef UART_AUTOBAUD_SNAP
+/**
+ * @brief Auto-baud snapping tolerance override
+ *
+ * Define this before including avr_uart_config.h to set how many percent a
+ * measured baud rate may be off a standard rate to be rounded to it. Rates
+ * further off are used as measured.
+ * Default: 3
+ */
+#define UART_AUTOBAUD_SNAP 3
+#endif
+
+#endif /* AVR_UART_AUTOBAUD */
+
+#ifndef UART_BAUD_MAX_ERROR
+/**
+ * @brief Baud rate error limit override
+ *
+ * Define this before including avr_uart_config.h to set the largest error,
+ * in 0.1 % units, of the closest rate F_CPU can divide down to against
+ * UART_BAUD_RATE. Builds with a larger error fail.
+ * Default: 20 (2 %)
+ */
+#define UART_BAUD_MAX_ERROR 20
+#endif
+
+#ifndef UART_RX_MAX_LATENCY_US
+/**
+ * @brief RX consumer latency override
+ *
+ * Define this before including avr_uart_config.h to the longest time, in
+ * microseconds, the application may leave the RX buffer unread, such as one
+ * main loop period. Builds fail if the RX buffer cannot hold what arrives at
+ * UART_BAUD_RATE in that time.
+ * Default: 0 (not checked)
+ */
+#define UART_RX_MAX_LATENCY_US 0
+#endif
+
+#ifndef UART_SRAM_MAX
+/**
+ * @brief SRAM budget override
+ *
+ * Define this before including avr_uart_config.h to set how many bytes
+ * UART_PLAN_SRAM may reach.
+ * Default: half the SRAM of the device
+ */
+#define UART_SRAM_MAX ((RAMEND - RAMSTART + 1) / 2)
+#endif
+
+/*
+ * Compile-time planning. For a constant baud rate the UART_PLAN_* macros are
+ * integer constant expressions, src/avr_uart.c programs UBRR and U2X from
+ * them and checks the configuration against them with _Static_assert.
+ */
+
+/**
+ * @brief Largest value of UBRR
+ */
+#define UART_PLAN_UBRR_MAX 4095
+
+/**
+ * @brief F_CPU / (samples * baud) rounded to the nearest integer
+ */
+#define UART_PLAN_DIVISOR_ROUNDED(baud, samples)                           \
+  (((uint32_t)F_CPU + (samples) / 2 * (uint32_t)(baud)) /                \
+   ((samples) * (uint32_t)(baud)))
+
+/**
+ * @brief Baud rate divisor for samples per bit, clamped to what UBRR holds
+ */
+#define UART_PLAN_DIVISOR(baud, samples)                                   \
+  (UART_PLAN_DIVISOR_ROUNDED(baud, samples) < 1 ? 1 :                      \
+   UART_PLAN_DIVISOR_ROUNDED(baud, samples) > UART_PLAN_UBRR_MAX + 1 ?     \
+   UART_PLAN_UBRR_MAX + 1 : UART_PLAN_DIVISOR_ROUNDED(baud, samples))
+
+/**
+ * @brief Rate achieved with samples per bit
+ */
+#define UART_PLAN_RATE(baud, samples)                                      \
+  ((uint32_t)F_CPU / ((samples) * (uint32_t)UART_PLAN_DIVISOR(baud, samples)))
+
+/**
+ * @brief Distance of the rate achieved with samples per bit from baud
+ */
+#define UART_PLAN_DIFF(baud, samples)                                      \
+  (UART_PLAN_RATE(baud, samples) > (uint32_t)(baud) ?                      \
+   UART_PLAN_RATE(baud, samples) - (uint32_t)(baud) :                      \
+   (uint32_t)(baud) - UART_PLAN_RATE(baud, samples))
+
+/**
+ * @brief Whether double speed mode gets closer to baud
+ *
+ * Double speed samples less and tolerates less skew, it is only chosen when
+ * it is strictly closer.
+ */
+#define UART_PLAN_U2X(baud)                                                \
+  (UART_PLAN_DIFF(baud, 8) < UART_PLAN_DIFF(baud, 16))
+
+/**
+ * @brief UBRR value for baud
+ */
+#define UART_PLAN_UBRR(baud)                                               \
+  (UART_PLAN_U2X(baud) ?                                                   \
+   UART_PLAN_DIVISOR(baud, 8) - 1 : UART_PLAN_DIVISOR(baud, 16) - 1)
+
+/**
+ * @brief Rate achieved for baud
+ */
+#define UART_PLAN_BAUD(baud)                                               \
+  (UART_PLAN_U2X(baud) ? UART_PLAN_RATE(baud, 8) : UART_PLAN_RATE(baud, 16))
+
+/**
+ * @brief Error of the rate achieved for baud, in 0.1 % units
+ *
+ * Has the sign of avr_uart_get_baud_error(), positive when faster.
+ */
+#define UART_PLAN_ERROR(baud)                                              \
+  (((int32_t)UART_PLAN_BAUD(baud) - (int32_t)(baud)) * 1000 /              \
+   (int32_t)(baud))
+
+/**
+ * @brief Bits of a character with the configured framing
+ */
+#define UART_PLAN_FRAME_BITS                                               \
+  (1 + UART_CHAR_SIZE + UART_STOP_BITS + (UART_PARITY != UART_PARITY_NONE))
+
+/**
+ * @brief Characters arriving at UART_BAUD_RATE within us, rounded up
+ */
+#define UART_PLAN_RX_CHARS(us)                                             \
+  (((unsigned long long)(us) * UART_BAUD_RATE +                            \
+    UART_PLAN_FRAME_BITS * 1000000ULL - 1) /                               \
+   (UART_PLAN_FRAME_BITS * 1000000ULL))
+
+/**
+ * @brief Bytes of a field sized for values up to n (uint8_t or uint16_t)
+ */
+#define UART_PLAN_WIDTH(n) ((n) < 256 ? 1 : 2)
+
+/**
+ * @brief Bytes of the buffers and state of the enabled features
+ *
+ * The ring buffers and the state of the pattern matcher and the frame, line,
+ * record and TX block layers, nearly all of the static data of the library.
+ * The per-feature figures follow the layout of the structures they describe,
+ * each module checks its figure against sizeof() so they cannot drift apart.
+ * avr-size reports the exact total.
+ */
+#define UART_PLAN_SRAM                                                     \
+  (UART_HAS_RX * UART_RX_BUFFER_LEN + UART_HAS_TX * UART_TX_BUFFER_LEN +   \
+   UART_PLAN_SRAM_MATCH + UART_PLAN_SRAM_FRAME + UART_PLAN_SRAM_LINE +     \
+   UART_PLAN_SRAM_RECORD + UART_PLAN_SRAM_TX_DESC)
+
+#ifdef AVR_UART_MATCH
+/* Count, length with two flag bits, pattern and handler of each slot */
+#define UART_PLAN_SRAM_MATCH_SLOT                                          \
+  (2 * UART_PLAN_WIDTH(UART_MAX_SEQ_LEN * 4) + sizeof(const char *) + 1 +  \
+   sizeof(void (*)(void *)) + sizeof(void *))
+/* Slots, pattern pool, and the active, triggered and pending masks */
+#define UART_PLAN_SRAM_MATCH_STATE                                         \
+  (1 + (1 + UART_PLAN_AUTOMATON) * UART_PLAN_WIDTH(UART_MATCH_POOL_LEN) +  \
+   UART_MATCH_MAX * UART_PLAN_SRAM_MATCH_SLOT + UART_MATCH_POOL_LEN +      \
+   (2 + UART_PLAN_AUTOMATON) * ((UART_MATCH_MAX + 7) / 8))
+#define UART_PLAN_SRAM_MATCH                                               \
+  (UART_PLAN_SRAM_MATCH_STATE + UART_PLAN_SRAM_AUTOMATON +                 \
+   UART_PLAN_SRAM_MATCH_QUEUE)
+#else
+#define UART_PLAN_SRAM_MATCH 0
+#endif
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+#define UART_PLAN_AUTOMATON 1
+#define UART_PLAN_NODE UART_PLAN_WIDTH(UART_MATCH_POOL_LEN + 1)
+/* Edge offsets, edges, and output and dictionary link of each node */
+#define UART_PLAN_SRAM_MATCH_TABLE                                         \
+  ((UART_MATCH_POOL_LEN + 2) * UART_PLAN_WIDTH(UART_MATCH_EDGE_MAX) +      \
+   UART_MATCH_EDGE_MAX * (1 + UART_PLAN_NODE) +                            \
+   (UART_MATCH_POOL_LEN + 1) * (1 + UART_PLAN_NODE) + UART_MATCH_MAX)
+/* State, and the table the ISR reads and the one registrations build */
+#define UART_PLAN_SRAM_AUTOMATON                                           \
+  (UART_PLAN_NODE + 1 + 2 * UART_PLAN_SRAM_MATCH_TABLE)
+#else
+#define UART_PLAN_AUTOMATON 0
+#define UART_PLAN_SRAM_AUTOMATON 0
+#endif
+
+#ifdef AVR_UART_NOBLOCK_MATCH
+/* Bytes the matcher has not seen, its indices and the busy flag */
+#define UART_PLAN_SRAM_MATCH_QUEUE (UART_MATCH_QUEUE_LEN + 1 + 3)
+#else
+#define UART_PLAN_SRAM_MATCH_QUEUE 0
+#endif
+
+#ifdef AVR_UART_FRAME
+/* Frame in progress, and length and error flag of each queued frame */
+#define UART_PLAN_SRAM_FRAME                                               \
+  (UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 1 +                               \
+   (UART_FRAME_QUEUE_LEN + 1) * (UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 1) + \
+   2)
+#else
+#define UART_PLAN_SRAM_FRAME 0
+#endif
+
+#ifdef AVR_UART_LINE
+/* Line in progress, length and flags of each queued line */
+#define UART_PLAN_SRAM_LINE_STATE                                          \
+  (UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 2 +                               \
+   (UART_LINE_QUEUE_LEN + 1) * (UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 1) + \
+   2)
+/* Echo queue and its indices */
+#define UART_PLAN_SRAM_ECHO (UART_ECHO_LEN + 2)
+#define UART_PLAN_SRAM_LINE (UART_PLAN_SRAM_LINE_STATE + UART_PLAN_SRAM_ECHO)
+#else
+#define UART_PLAN_SRAM_LINE 0
+#endif
+
+#ifdef AVR_UART_RECORD
+#define UART_PLAN_RECORD_CRC (UART_RECORD_CRC == UART_RECORD_CRC8 ? 1 : 2)
+/* Record in progress, and length and error flag of each queued record */
+#define UART_PLAN_SRAM_RECORD_STATE                                        \
+  (3 * UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 1 + UART_PLAN_RECORD_CRC +    \
+   (UART_RECORD_QUEUE_LEN + 1) * (UART_PLAN_WIDTH(UART_RX_BUFFER_LEN) + 1) + \
+   2)
+/* Transmit buffer span and CRC of the record being written */
+#define UART_PLAN_SRAM_RECORD_WRITER                                       \
+  (sizeof(char *) + 2 * sizeof(size_t) + UART_PLAN_RECORD_CRC)
+#define UART_PLAN_SRAM_RECORD                                              \
+  (UART_HAS_RX * UART_PLAN_SRAM_RECORD_STATE +                             \
+   UART_HAS_TX * UART_PLAN_SRAM_RECORD_WRITER)
+#else
+#define UART_PLAN_SRAM_RECORD 0
+#endif
+
+#ifdef AVR_UART_TX_DESC
+/* Pointer, length, marker, flag and done handler with its data per block */
+#define UART_PLAN_SRAM_TX_DESC_SLOT                                        \
+  (sizeof(const char *) + sizeof(size_t) +                                 \
+   UART_PLAN_WIDTH(UART_TX_BUFFER_LEN - 1) + 1 +                           \
+   sizeof(void (*)(void *)) + sizeof(void *))
+#define UART_PLAN_SRAM_TX_DESC                                             \
+  (UART_TX_DESC_QUEUE_LEN * UART_PLAN_SRAM_TX_DESC_SLOT + 3)
+#else
+#define UART_PLAN_SRAM_TX_DESC 0
+#endif
+
 #endif /* _AVR_UART_UART_CONFIG_H_ */
@@ -0,0 +1,99 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_FRAME_H_
+#define _AVR_UART_FRAME_H_
+
+/**
+ * @file avr_uart_frame.h
+ * @author notweerdmonk
+ * @brief Packet framing API for UART
+ *
+ * This module splits the received byte stream into SLIP or COBS encoded
+ * frames and encodes outgoing frames straight into the transmit buffer.
+ *
+ * Features:
+ * - Frame boundaries found in ISR context as bytes arrive
+ * - Constant time check for complete frames
+ * - Frames decoded from, and encoded into, the UART buffers in place
+ *
+ * @note This feature requires AVR_UART_FRAME to be defined
+ * @note While framing is enabled the frame API owns the receive buffer,
+ *       do not mix it with avr_uart_recv() and friends
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr_uart.h>
+
+/**
+ * @brief Returned by avr_uart_frame_recv() for a frame that was discarded
+ */
+#define UART_FRAME_ERROR ((size_t)-1)
+
+/**
+ * @brief Get the number of complete frames waiting in the receive buffer
+ *
+ * @return Number of frames that avr_uart_frame_recv() returns without
+ *         blocking
+ *
+ * @code
+ * if (avr_uart_frame_available()) {
+ *     size_t n = avr_uart_frame_recv(packet, sizeof(packet));
+ * }
+ * @endcode
+ */
+uint8_t avr_uart_frame_available(void);
+
+/**
+ * @brief Receive and decode one frame
+ *
+ * Waits for a complete frame, decodes it into buf and removes it from the
+ * receive buffer. Repeated delimiters between frames are skipped.
+ *
+ * @param buf Buffer to receive the decoded frame
+ * @param len Size of buf
+ * @return Decoded length, or UART_FRAME_ERROR if the frame lost bytes to
+ *         a full receive buffer or frame queue, is not validly encoded or
+ *         does not fit buf
+ *
+ * @note This function blocks until a frame is available
+ */
+size_t avr_uart_frame_recv(char *buf, size_t len);
+
+#if UART_HAS_TX
+
+/**
+ * @brief Encode and send one frame
+ *
+ * Writes the delimited and escaped frame directly into the transmit
+ * buffer, waiting for space as needed.
+ *
+ * @param buf Frame payload
+ * @param len Payload length
+ */
+void avr_uart_frame_send(const char *buf, size_t len);
+
+#endif /* UART_HAS_TX */
+
+#endif /* _AVR_UART_FRAME_H_ */
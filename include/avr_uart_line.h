@@ -0,0 +1,115 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_LINE_H_
+#define _AVR_UART_LINE_H_
+
+/**
+ * @file avr_uart_line.h
+ * @author notweerdmonk
+ * @brief Line discipline API for UART
+ *
+ * This module splits the received byte stream into lines ended by CR, LF
+ * or CR LF, for consoles that read commands a line at a time.
+ *
+ * Features:
+ * - Line ends found in ISR context as bytes arrive
+ * - Constant time check for complete lines
+ * - A complete line copied out of the receive buffer in bulk
+ * - Optional backspace editing and local echo from the RX ISR
+ *
+ * @note This feature requires AVR_UART_LINE to be defined
+ * @note While the line discipline is enabled it owns the receive buffer,
+ *       do not mix it with avr_uart_recv() and friends
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr_uart.h>
+
+/**
+ * @brief Returned by avr_uart_readline() when no line is complete yet
+ */
+#define UART_LINE_NONE ((size_t)-1)
+
+/**
+ * @brief Returned by avr_uart_readline() for a line that was discarded
+ */
+#define UART_LINE_ERROR ((size_t)-2)
+
+/**
+ * @brief Echo received characters, and CR LF for a line end
+ *
+ * The echo is sent ahead of the transmit buffer, so it interleaves with
+ * output queued before it, and is lost when UART_ECHO_LEN bytes are waiting.
+ */
+#define UART_LINE_ECHO 0x01
+
+/**
+ * @brief Backspace and DEL erase the last character of the line in progress
+ */
+#define UART_LINE_EDIT 0x02
+
+/**
+ * @brief Set the line discipline mode
+ *
+ * @param mode UART_LINE_ECHO and UART_LINE_EDIT or'ed together, none are
+ *             set after reset
+ *
+ * @code
+ * avr_uart_line_mode(UART_LINE_ECHO | UART_LINE_EDIT);
+ * @endcode
+ */
+void avr_uart_line_mode(uint8_t mode);
+
+/**
+ * @brief Get the number of complete lines waiting in the receive buffer
+ *
+ * @return Number of lines that avr_uart_readline() returns
+ */
+uint8_t avr_uart_line_available(void);
+
+/**
+ * @brief Receive one complete line
+ *
+ * Copies the oldest complete line without its line end into buf, adds a
+ * terminating null character and removes the line from the receive buffer.
+ * Returns at once when no line is complete.
+ *
+ * @param buf Buffer to receive the line
+ * @param max Size of buf, including the null character
+ * @return Line length, UART_LINE_NONE if no line is complete, or
+ *         UART_LINE_ERROR if the line lost bytes to a full receive buffer
+ *         or line queue, or does not fit buf
+ *
+ * @code
+ * char cmd[32];
+ * size_t n = avr_uart_readline(cmd, sizeof(cmd));
+ * if (n != UART_LINE_NONE && n != UART_LINE_ERROR) {
+ *     run_command(cmd, n);
+ * }
+ * @endcode
+ */
+size_t avr_uart_readline(char *buf, size_t max);
+
+#endif /* _AVR_UART_LINE_H_ */
@@ -36,11 +36,15 @@
  * - Register multiple patterns to match against incoming data
  * - Non-blocking pattern detection in ISR context
  * - Callback functions executed when patterns are matched
+ * - Patterns and whole pattern tables can stay in flash
+ * - Optional Aho-Corasick automaton (AVR_UART_AUTOMATON_MATCH) that finds
+ *   overlapping occurrences with one table transition per received byte
  *
  * @note This feature requires AVR_UART_MATCH to be defined
  */
 
 #include <stdint.h>
+#include <avr/pgmspace.h>
 #include <avr_uart.h>
 
 /**
@@ -61,6 +65,40 @@
  */
 typedef void (*avr_uart_match_handler)(void *);
 
+/**
+ * @brief Handle of a registered pattern
+ *
+ * Holds the match slot in the low byte and the slot generation in the high
+ * byte, so a stale handle to a reused slot is recognised.
+ */
+typedef uint16_t avr_uart_match_handle;
+
+/**
+ * @brief Returned by the registration functions on failure
+ */
+#define UART_MATCH_HANDLE_INVALID ((avr_uart_match_handle)0xFFFF)
+
+/**
+ * @brief Pattern table entry for avr_uart_register_match_table_P()
+ *
+ * Tables and the pattern strings they point to are placed in flash.
+ *
+ * @code
+ * static const char cmd_on[] PROGMEM = "on";
+ * static const char cmd_off[] PROGMEM = "off";
+ *
+ * static const struct avr_uart_match_entry commands[] PROGMEM = {
+ *     { cmd_on,  on_command,  NULL },
+ *     { cmd_off, off_command, NULL },
+ * };
+ * @endcode
+ */
+struct avr_uart_match_entry {
+  PGM_P str;                       /**< Pattern string in flash */
+  avr_uart_match_handler handler;  /**< Callback function */
+  void *data;                      /**< User data passed to handler */
+};
+
 /**
  * @brief Register a pattern to match against incoming UART data
  *
@@ -70,11 +108,18 @@ typedef void (*avr_uart_match_handler)(void *);
  * @param str     Pattern string to match (null-terminated)
  * @param handler Callback function to execute when pattern matches
  * @param data    User data to pass to callback (can be NULL)
- * @return 0 on success, -1 on failure (no handler or max patterns reached)
+ * @return Handle for avr_uart_deregister_match_handle(), or
+ *         UART_MATCH_HANDLE_INVALID on failure (no handler, empty pattern,
+ *         max patterns reached, pattern pool full or, with
+ *         AVR_UART_AUTOMATON_MATCH, more than UART_MATCH_EDGE_MAX edges)
  *
- * @note Pattern length cannot exceed UART_MAX_SEQ_LEN
- * @note Maximum UART_MATCH_MAX patterns can be registered
+ * @note Pattern length cannot exceed UART_MAX_SEQ_LEN, longer patterns are
+ *       truncated
+ * @note Maximum UART_MATCH_MAX patterns can be registered, sharing
+ *       UART_MATCH_POOL_LEN bytes
  * @note Pattern matching occurs in ISR context
+ * @note With AVR_UART_AUTOMATON_MATCH the automaton is rebuilt in a second
+ *       table with the RXC interrupt enabled and swapped in with it masked
  *
  * @code
  * void on_command(void *data) {
@@ -85,22 +130,114 @@ typedef void (*avr_uart_match_handler)(void *);
  * avr_uart_register_match("cmd", on_command, NULL);
  * @endcode
  */
-uint8_t avr_uart_register_match(const char *str, avr_uart_match_handler handler,
-    void *data);
+avr_uart_match_handle avr_uart_register_match(const char *str,
+    avr_uart_match_handler handler, void *data);
+
+/**
+ * @brief Register a pattern stored in flash
+ *
+ * Like avr_uart_register_match() but the pattern is read from program
+ * memory in place and takes no space in the pattern pool.
+ *
+ * @param str     Pattern string in program memory (null-terminated)
+ * @param handler Callback function to execute when pattern matches
+ * @param data    User data to pass to callback (can be NULL)
+ * @return Handle for avr_uart_deregister_match_handle(), or
+ *         UART_MATCH_HANDLE_INVALID on failure (no handler, empty pattern or
+ *         max patterns reached)
+ *
+ * @code
+ * avr_uart_register_match_P(PSTR("cmd"), on_command, NULL);
+ * @endcode
+ */
+avr_uart_match_handle avr_uart_register_match_P(PGM_P str,
+    avr_uart_match_handler handler, void *data);
+
+/**
+ * @brief Register every pattern of a table stored in flash
+ *
+ * @param table Array of entries in program memory
+ * @param count Number of entries in table
+ * @return 0 on success, -1 if an entry could not be registered, entries
+ *         before it stay registered unless the automaton of
+ *         AVR_UART_AUTOMATON_MATCH runs out of edges, then none do
+ *
+ * @note The matcher is updated once for the whole table
+ *
+ * @code
+ * avr_uart_register_match_table_P(commands,
+ *     sizeof(commands) / sizeof(commands[0]));
+ * @endcode
+ */
+uint8_t avr_uart_register_match_table_P(
+    const struct avr_uart_match_entry *table, uint8_t count);
+
+#ifdef AVR_UART_ISR_MATCH
+
+/**
+ * @brief Register a pattern whose handler runs in the RX ISR
+ *
+ * Like avr_uart_register_match() but the handler is called from the RX
+ * ISR as soon as the last byte of the pattern arrives, without waiting for
+ * avr_uart_check_match().
+ *
+ * @param str     Pattern string to match (null-terminated)
+ * @param handler Callback function, runs with interrupts disabled, or
+ *                enabled with AVR_UART_NOBLOCK_MATCH
+ * @param data    User data to pass to callback (can be NULL)
+ * @return Handle for avr_uart_deregister_match_handle(), or
+ *         UART_MATCH_HANDLE_INVALID on failure
+ *
+ * @note Requires AVR_UART_ISR_MATCH
+ * @note Keep the handler short, every received byte waits for it. With
+ *       AVR_UART_NOBLOCK_MATCH bytes are still stored meanwhile, but at
+ *       most UART_MATCH_QUEUE_LEN of them are matched afterwards
+ *
+ * @code
+ * void on_estop(void *data) {
+ *     MOTOR_PORT &= ~_BV(MOTOR_EN);
+ * }
+ *
+ * avr_uart_register_match_isr("\x1B!STOP", on_estop, NULL);
+ * @endcode
+ */
+avr_uart_match_handle avr_uart_register_match_isr(const char *str,
+    avr_uart_match_handler handler, void *data);
+
+#endif /* AVR_UART_ISR_MATCH */
 
 /**
  * @brief Deregister a previously registered pattern
  *
- * Removes a pattern from the match list.
+ * Removes the first registered pattern equal to str from the match list.
  *
  * @param str Pattern string to remove (must match exactly)
  *
+ * @note Searches every registered pattern, prefer
+ *       avr_uart_deregister_match_handle()
+ *
  * @code
  * avr_uart_deregister_match("cmd");  // Remove "cmd" pattern
  * @endcode
  */
 void avr_uart_deregister_match(const char *str);
 
+/**
+ * @brief Deregister a pattern by its handle
+ *
+ * Clears the slot in constant time. The RX ISR stops matching the pattern
+ * at once and a trigger still pending for it is not dispatched. Stale or
+ * invalid handles are ignored.
+ *
+ * @param handle Handle returned when the pattern was registered
+ *
+ * @code
+ * avr_uart_match_handle h = avr_uart_register_match("boot", on_boot, NULL);
+ * avr_uart_deregister_match_handle(h);
+ * @endcode
+ */
+void avr_uart_deregister_match_handle(avr_uart_match_handle handle);
+
 /**
  * @brief Check for and process triggered pattern matches
  *
@@ -108,6 +245,10 @@ void avr_uart_deregister_match(const char *str);
  * patterns that were matched in the ISR. Calls the registered
  * handler for each triggered pattern.
  *
+ * The triggered flags are taken and cleared atomically, one byte of eight
+ * patterns at a time, and only the set flags are visited. Returns at once
+ * when no pattern triggered.
+ *
  * @note This function should be called from non-ISR context
  *
  * @code
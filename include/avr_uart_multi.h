@@ -0,0 +1,372 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_MULTI_H_
+#define _AVR_UART_MULTI_H_
+
+/**
+ * @file avr_uart_multi.h
+ * @author notweerdmonk
+ * @brief Buffered drivers for the additional USARTs of multi-USART parts
+ *
+ * Parts like the ATmega2560 (USART0-3) and ATmega328PB (USART0-1) have more
+ * than the one USART driven by avr_uart.c. AVR_UART_DEFINE_PORT() expands to
+ * a driver for one of them: its ring buffers, its RXC and UDRE ISRs and a
+ * set of functions named after the port. The rings use the index helpers,
+ * ISR-safe accesses and blocking wait of avr_uart.c from avr_uart_ring.h,
+ * and the baud rate is planned and checked by the same UART_PLAN_* macros.
+ *
+ * Features:
+ * - Separate RX and TX buffer lengths per port
+ * - Character size, parity and stop bits per port
+ * - No port handle is passed at run time, each function and ISR is
+ *   specialized for its USART and buffers, so register and buffer addresses
+ *   are constants
+ * - Lock-free single-producer/single-consumer rings as with AVR_UART_SPSC
+ * - Bulk copies in at most two contiguous spans
+ * - Latched overflow, overrun, frame and parity errors
+ *
+ * @code
+ * // gateway.c
+ * #include <avr_uart_multi.h>
+ *
+ * AVR_UART_DEFINE_PORT(modem, 1, 57600, 128, 64)
+ * AVR_UART_DEFINE_PORT_FORMAT(gps, 2, 9600, 64, 16,
+ *     8, AVR_UART_PORT_PARITY_NONE, 1)
+ *
+ * int main(void) {
+ *     avr_uart_port_setup(modem);
+ *     avr_uart_port_setup(gps);
+ *     sei();
+ *
+ *     char c;
+ *     for (;;) {
+ *         if (avr_uart_port_try_recv(gps, &c)) {
+ *             avr_uart_port_send_byte(modem, c);
+ *         }
+ *     }
+ * }
+ * @endcode
+ *
+ * @note The USART used by avr_uart.c (USART0 with the stock port layer) must
+ *       not be defined again here, its vectors are already taken
+ * @note Pattern matching, framing, statistics and the other optional
+ *       features are only available on the avr_uart.c port
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr_uart.h>
+#include <avr_uart_ring.h>
+
+/*
+ * Bit positions of the USART control and status registers are the same for
+ * every USART of a part, the USART0 bit names are used for all of them.
+ */
+
+#define AVR_UART_PORT_PARITY_NONE 0
+/**< No parity bit */
+#define AVR_UART_PORT_PARITY_EVEN 2
+/**< Even parity, the UPM field value */
+#define AVR_UART_PORT_PARITY_ODD  3
+/**< Odd parity, the UPM field value */
+
+/**
+ * @brief Declare the functions of a port defined in another source file
+ *
+ * @param name Port name given to AVR_UART_DEFINE_PORT()
+ */
+#define AVR_UART_DECLARE_PORT(name)                                      \
+  void avr_uart_##name##_setup(void);                                    \
+  void avr_uart_##name##_flush_rx(void);                                 \
+  void avr_uart_##name##_flush_tx(void);                                 \
+  size_t avr_uart_##name##_available(void);                              \
+  uint8_t avr_uart_##name##_rx_error(void);                              \
+  char avr_uart_##name##_recv_byte(void);                                \
+  uint8_t avr_uart_##name##_try_recv(char *c);                           \
+  size_t avr_uart_##name##_recv(char *str, size_t len);                  \
+  void avr_uart_##name##_send_byte(char c);                              \
+  char avr_uart_##name##_try_send_byte(char c);                          \
+  void avr_uart_##name##_send(const char *s, size_t len);                \
+  void avr_uart_##name##_pgm_send(PGM_P s)
+
+/**
+ * @brief Define the driver of one USART running 8N1
+ *
+ * @see AVR_UART_DEFINE_PORT_FORMAT()
+ */
+#define AVR_UART_DEFINE_PORT(name, n, baud, rx_len, tx_len)              \
+  AVR_UART_DEFINE_PORT_FORMAT(name, n, baud, rx_len, tx_len,             \
+      8, AVR_UART_PORT_PARITY_NONE, 1)
+
+/**
+ * @brief Define the driver of one USART
+ *
+ * Expands to the state, ISRs and functions of the port. Use it once per port
+ * at file scope of one source file, other files use AVR_UART_DECLARE_PORT().
+ * One slot of each ring is kept empty, so a ring holds len - 1 bytes. The
+ * divisor and double speed mode are chosen as for UART_BAUD_RATE and a rate
+ * further than UART_BAUD_MAX_ERROR off at F_CPU fails to compile.
+ *
+ * @param name      Port name, functions are called avr_uart_<name>_<function>
+ * @param n         USART number, e.g. 1 for USART1
+ * @param baud      Baud rate, a compile time constant
+ * @param rx_len    RX buffer length in bytes (2..65535)
+ * @param tx_len    TX buffer length in bytes (2..65535)
+ * @param char_size Data bits (5..8)
+ * @param parity    AVR_UART_PORT_PARITY_NONE, _EVEN or _ODD
+ * @param stop_bits Stop bits (1 or 2)
+ */
+#define AVR_UART_DEFINE_PORT_FORMAT(name, n, baud, rx_len, tx_len,       \
+    char_size, parity, stop_bits)                                        \
+                                                                         \
+  AVR_UART_DECLARE_PORT(name);                                           \
+                                                                         \
+  _Static_assert((rx_len) > 1 && (rx_len) <= 0xffff &&                   \
+      (tx_len) > 1 && (tx_len) <= 0xffff,                                \
+      "USART" #n " buffer lengths must be 2..65535");                    \
+  _Static_assert((char_size) >= 5 && (char_size) <= 8,                   \
+      "USART" #n " character size must be 5..8");                        \
+  _Static_assert((stop_bits) == 1 || (stop_bits) == 2,                   \
+      "USART" #n " stop bits must be 1 or 2");                           \
+  _Static_assert((parity) == AVR_UART_PORT_PARITY_NONE ||                \
+      (parity) == AVR_UART_PORT_PARITY_EVEN ||                           \
+      (parity) == AVR_UART_PORT_PARITY_ODD,                              \
+      "USART" #n " parity must be AVR_UART_PORT_PARITY_*");              \
+  _Static_assert(UART_PLAN_ERROR(baud) <= UART_BAUD_MAX_ERROR &&         \
+      UART_PLAN_ERROR(baud) >= -UART_BAUD_MAX_ERROR,                     \
+      "USART" #n " baud rate is further than UART_BAUD_MAX_ERROR off");  \
+                                                                         \
+  typedef UART_SIZE_TYPE((rx_len) - 1) avr_uart_##name##_rx_index_t;     \
+  typedef UART_SIZE_TYPE((tx_len) - 1) avr_uart_##name##_tx_index_t;     \
+                                                                         \
+  static struct {                                                        \
+    char rx_buffer[rx_len];                                              \
+    char tx_buffer[tx_len];                                              \
+    volatile avr_uart_##name##_rx_index_t rx_in;                         \
+    volatile avr_uart_##name##_rx_index_t rx_out;                        \
+    volatile avr_uart_##name##_tx_index_t tx_in;                         \
+    volatile avr_uart_##name##_tx_index_t tx_out;                        \
+    volatile uint8_t rx_error;                                           \
+  } avr_uart_##name;                                                     \
+                                                                         \
+  static inline size_t avr_uart_##name##_tx_count(void) {                \
+    avr_uart_##name##_tx_index_t tx_in = avr_uart_##name.tx_in;          \
+    avr_uart_##name##_tx_index_t tx_out =                                \
+      UART_ATOMIC_LOAD(avr_uart_##name.tx_out);                          \
+    return UART_RING_COUNT((size_t)tx_in, (size_t)tx_out, (size_t)(tx_len)); \
+  }                                                                      \
+                                                                         \
+  ISR(USART##n##_UDRE_vect, ISR_BLOCK) {                                 \
+    avr_uart_##name##_tx_index_t tx_out = avr_uart_##name.tx_out;        \
+                                                                         \
+    if (tx_out != avr_uart_##name.tx_in) {                               \
+      UDR##n = avr_uart_##name.tx_buffer[tx_out];                        \
+      avr_uart_##name.tx_out = tx_out = UART_RING_NEXT(tx_out, tx_len);  \
+    }                                                                    \
+                                                                         \
+    if (tx_out == avr_uart_##name.tx_in) {                               \
+      UCSR##n##B &= ~_BV(UDRIE0);                                        \
+    }                                                                    \
+  }                                                                      \
+                                                                         \
+  ISR(USART##n##_RX_vect, ISR_BLOCK) {                                   \
+    /* Error flags are only valid until UDR is read */                   \
+    uint8_t status = UCSR##n##A;                                         \
+    uint8_t udr = UDR##n;                                                \
+    avr_uart_##name##_rx_index_t rx_in = avr_uart_##name.rx_in;          \
+    avr_uart_##name##_rx_index_t rx_next =                               \
+      UART_RING_NEXT(rx_in, rx_len);                                     \
+                                                                         \
+    avr_uart_##name.rx_error |=                                          \
+      (status & _BV(DOR0) ? UART_RX_ERROR_DATA_OVERRUN : 0) |            \
+      (status & _BV(FE0) ? UART_RX_ERROR_FRAME : 0) |                    \
+      (status & _BV(UPE0) ? UART_RX_ERROR_PARITY : 0);                   \
+                                                                         \
+    /* A full ring drops the byte, rx_out belongs to the main loop */    \
+    if (rx_next == avr_uart_##name.rx_out) {                             \
+      avr_uart_##name.rx_error |= UART_RX_ERROR_OVERFLOW;                \
+      return;                                                            \
+    }                                                                    \
+                                                                         \
+    avr_uart_##name.rx_buffer[rx_in] = udr;                              \
+    avr_uart_##name.rx_in = rx_next;                                     \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_setup(void) {                                   \
+    UCSR##n##B = 0;                                                      \
+    avr_uart_##name.rx_in = avr_uart_##name.rx_out = 0;                  \
+    avr_uart_##name.tx_in = avr_uart_##name.tx_out = 0;                  \
+    avr_uart_##name.rx_error = 0;                                        \
+    UBRR##n = UART_PLAN_UBRR(baud);                                      \
+    UCSR##n##A = UART_PLAN_U2X(baud) ? _BV(U2X0) : 0;                    \
+    UCSR##n##C = (((char_size) - 5) << UCSZ00) |                         \
+      ((parity) << UPM00) | ((stop_bits) == 2 ? _BV(USBS0) : 0);         \
+    UCSR##n##B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);                  \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_flush_rx(void) {                                \
+    UART_ATOMIC_STORE(avr_uart_##name.rx_out,                            \
+        UART_ATOMIC_LOAD(avr_uart_##name.rx_in));                        \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_flush_tx(void) {                                \
+    UART_WAIT_WHILE(avr_uart_##name##_tx_count() > 0);                   \
+  }                                                                      \
+                                                                         \
+  size_t avr_uart_##name##_available(void) {                             \
+    avr_uart_##name##_rx_index_t rx_in =                                 \
+      UART_ATOMIC_LOAD(avr_uart_##name.rx_in);                           \
+    avr_uart_##name##_rx_index_t rx_out = avr_uart_##name.rx_out;        \
+    return UART_RING_COUNT((size_t)rx_in, (size_t)rx_out, (size_t)(rx_len)); \
+  }                                                                      \
+                                                                         \
+  uint8_t avr_uart_##name##_rx_error(void) {                             \
+    uint8_t error;                                                       \
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                                  \
+      error = avr_uart_##name.rx_error;                                  \
+      avr_uart_##name.rx_error = 0;                                      \
+    }                                                                    \
+    return error;                                                        \
+  }                                                                      \
+                                                                         \
+  uint8_t avr_uart_##name##_try_recv(char *c) {                          \
+    avr_uart_##name##_rx_index_t rx_out = avr_uart_##name.rx_out;        \
+                                                                         \
+    if (rx_out == UART_ATOMIC_LOAD(avr_uart_##name.rx_in)) {             \
+      return 0;                                                          \
+    }                                                                    \
+                                                                         \
+    *c = avr_uart_##name.rx_buffer[rx_out];                              \
+    UART_ATOMIC_STORE(avr_uart_##name.rx_out,                            \
+        UART_RING_NEXT(rx_out, rx_len));                                 \
+    return 1;                                                            \
+  }                                                                      \
+                                                                         \
+  char avr_uart_##name##_recv_byte(void) {                               \
+    char c;                                                              \
+    UART_WAIT_WHILE(!avr_uart_##name##_try_recv(&c));                    \
+    return c;                                                            \
+  }                                                                      \
+                                                                         \
+  size_t avr_uart_##name##_recv(char *str, size_t len) {                 \
+    size_t left = len;                                                   \
+                                                                         \
+    while (left > 0) {                                                   \
+      size_t count;                                                      \
+      UART_WAIT_WHILE((count = avr_uart_##name##_available()) == 0);     \
+                                                                         \
+      avr_uart_##name##_rx_index_t rx_out = avr_uart_##name.rx_out;      \
+      size_t span = (size_t)(rx_len) - rx_out;                           \
+      if (count > left) {                                                \
+        count = left;                                                    \
+      }                                                                  \
+      if (span > count) {                                                \
+        span = count;                                                    \
+      }                                                                  \
+                                                                         \
+      memcpy(str, &avr_uart_##name.rx_buffer[rx_out], span);             \
+      UART_ATOMIC_STORE(avr_uart_##name.rx_out,                          \
+          UART_RING_WRAP(rx_out + span, rx_len));                        \
+      str += span;                                                       \
+      left -= span;                                                      \
+    }                                                                    \
+    return len;                                                          \
+  }                                                                      \
+                                                                         \
+  char avr_uart_##name##_try_send_byte(char c) {                         \
+    avr_uart_##name##_tx_index_t tx_in = avr_uart_##name.tx_in;          \
+    avr_uart_##name##_tx_index_t tx_next =                               \
+      UART_RING_NEXT(tx_in, tx_len);                                     \
+                                                                         \
+    if (tx_next == UART_ATOMIC_LOAD(avr_uart_##name.tx_out)) {           \
+      return 0;                                                          \
+    }                                                                    \
+                                                                         \
+    avr_uart_##name.tx_buffer[tx_in] = c;                                \
+    UART_ATOMIC_STORE(avr_uart_##name.tx_in, tx_next);                   \
+    UCSR##n##B |= _BV(UDRIE0);                                           \
+    return 1;                                                            \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_send_byte(char c) {                             \
+    UART_WAIT_WHILE(!avr_uart_##name##_try_send_byte(c));                \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_send(const char *s, size_t len) {               \
+    while (len > 0) {                                                    \
+      size_t count;                                                      \
+      UART_WAIT_WHILE((count = (size_t)(tx_len) - 1 -                    \
+            avr_uart_##name##_tx_count()) == 0);                         \
+                                                                         \
+      avr_uart_##name##_tx_index_t tx_in = avr_uart_##name.tx_in;        \
+      size_t span = (size_t)(tx_len) - tx_in;                            \
+      if (count > len) {                                                 \
+        count = len;                                                     \
+      }                                                                  \
+      if (span > count) {                                                \
+        span = count;                                                    \
+      }                                                                  \
+                                                                         \
+      memcpy(&avr_uart_##name.tx_buffer[tx_in], s, span);                \
+      UART_ATOMIC_STORE(avr_uart_##name.tx_in,                           \
+          UART_RING_WRAP(tx_in + span, tx_len));                         \
+      UCSR##n##B |= _BV(UDRIE0);                                         \
+      s += span;                                                         \
+      len -= span;                                                       \
+    }                                                                    \
+  }                                                                      \
+                                                                         \
+  void avr_uart_##name##_pgm_send(PGM_P s) {                             \
+    for (char c = pgm_read_byte(s); c != 0; c = pgm_read_byte(++s)) {    \
+      avr_uart_##name##_send_byte(c);                                    \
+    }                                                                    \
+  }
+
+/**
+ * @name Port API
+ *
+ * Calls taking the port name as handle. The handle selects the specialized
+ * function at compile time, e.g. avr_uart_port_send(gps, s, len) calls
+ * avr_uart_gps_send(s, len).
+ * @{
+ */
+#define avr_uart_port_setup(port)            avr_uart_##port##_setup()
+#define avr_uart_port_flush_rx(port)         avr_uart_##port##_flush_rx()
+#define avr_uart_port_flush_tx(port)         avr_uart_##port##_flush_tx()
+#define avr_uart_port_available(port)        avr_uart_##port##_available()
+#define avr_uart_port_rx_error(port)         avr_uart_##port##_rx_error()
+#define avr_uart_port_recv_byte(port)        avr_uart_##port##_recv_byte()
+#define avr_uart_port_try_recv(port, c)      avr_uart_##port##_try_recv(c)
+#define avr_uart_port_recv(port, str, len)   avr_uart_##port##_recv(str, len)
+#define avr_uart_port_send_byte(port, c)     avr_uart_##port##_send_byte(c)
+#define avr_uart_port_try_send_byte(port, c) \
+  avr_uart_##port##_try_send_byte(c)
+#define avr_uart_port_send(port, s, len)     avr_uart_##port##_send(s, len)
+#define avr_uart_port_pgm_send(port, s)      avr_uart_##port##_pgm_send(s)
+/** @} */
+
+#endif /* _AVR_UART_MULTI_H_ */
@@ -0,0 +1,84 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_PRINTF_H_
+#define _AVR_UART_PRINTF_H_
+
+/**
+ * @file avr_uart_printf.h
+ * @author notweerdmonk
+ * @brief Formatted output straight into the UART transmit buffer
+ *
+ * A small printf that does not use avr-libc's vfprintf or a FILE stream.
+ * Literal text is enqueued in bulk and every conversion is formatted with
+ * the division-free number formatters before it is enqueued at once.
+ *
+ * Supported conversions: %d %i %u %x %X %c %s %S (string in flash) %f %%
+ * with the flags '-' and '0', a field width, a precision (decimals of %f,
+ * maximum length of %s and %S) and the length modifiers h, hh and l.
+ *
+ * @note This feature requires AVR_UART_PRINTF to be defined
+ * @note Widths and precisions given as '*' and the %e, %g, %o, %p and %n
+ *       conversions are not supported
+ * @note Widths and precisions above 255 are taken as 255, %f prints at most
+ *       9 decimals
+ */
+
+#include <stdarg.h>
+#include <avr/pgmspace.h>
+
+/**
+ * @brief Send formatted text
+ *
+ * @param fmt Format string in RAM
+ * @return Number of characters sent
+ *
+ * @code
+ * avr_uart_printf("t=%lu v=%.2f\r\n", millis, volts);
+ * @endcode
+ */
+int avr_uart_printf(const char *fmt, ...);
+
+/**
+ * @brief Send formatted text with the format string in flash
+ *
+ * @param fmt Format string in program memory
+ * @return Number of characters sent
+ *
+ * @code
+ * avr_uart_printf_P(PSTR("%S: %d\r\n"), PSTR("temp"), t);
+ * @endcode
+ */
+int avr_uart_printf_P(PGM_P fmt, ...);
+
+/**
+ * @brief avr_uart_printf() taking a va_list
+ */
+int avr_uart_vprintf(const char *fmt, va_list ap);
+
+/**
+ * @brief avr_uart_printf_P() taking a va_list
+ */
+int avr_uart_vprintf_P(PGM_P fmt, va_list ap);
+
+#endif /* _AVR_UART_PRINTF_H_ */
@@ -0,0 +1,186 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_RECORD_H_
+#define _AVR_UART_RECORD_H_
+
+/**
+ * @file avr_uart_record.h
+ * @author notweerdmonk
+ * @brief Checksummed binary record API for UART
+ *
+ * This module sends binary records of little-endian fields followed by a
+ * CRC trailer, and checks fixed length records as they are received.
+ *
+ * Features:
+ * - Fields written straight into the transmit buffer
+ * - CRC updated as each byte is written or stored, in a single pass
+ * - Nibble-wise CRC with a 16 entry table in flash
+ * - Constant time check for complete, verified records
+ *
+ * The CRC is CRC-16/MODBUS or, with UART_RECORD_CRC set to
+ * UART_RECORD_CRC8, the Maxim CRC-8. Both are reflected and sent low byte
+ * first, so the CRC over a record and its trailer is zero.
+ *
+ * @note This feature requires AVR_UART_RECORD to be defined
+ * @note While a record length is set the record API owns the receive
+ *       buffer, do not mix it with avr_uart_recv() and friends
+ * @note Records are binary, so AVR_UART_XONXOFF cannot be used with them
+ * @note Records carry no delimiter. A byte that did not fit the RX buffer
+ *       still counts towards its record, but a byte lost to a hardware
+ *       overrun (DOR) or a record the peer started before
+ *       avr_uart_record_length() shifts every later record. Resynchronise
+ *       by calling avr_uart_record_length() again once the line is idle.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr_uart.h>
+
+#if (UART_RECORD_CRC == UART_RECORD_CRC8)
+/**
+ * @brief Bytes of the CRC trailer
+ */
+#define UART_RECORD_CRC_LEN 1
+#else
+#define UART_RECORD_CRC_LEN 2
+#endif
+
+/**
+ * @brief Returned by avr_uart_record_recv() when no record is complete yet
+ */
+#define UART_RECORD_NONE ((size_t)-1)
+
+/**
+ * @brief Returned by avr_uart_record_recv() for a record that was discarded
+ */
+#define UART_RECORD_ERROR ((size_t)-2)
+
+#if UART_HAS_TX
+
+/**
+ * @brief Start a record
+ *
+ * @note Nothing else may be sent until avr_uart_record_end(), the fields
+ *       are written into transmit buffer space that is not yet committed
+ *
+ * @code
+ * avr_uart_record_begin();
+ * avr_uart_record_u8(SAMPLE_ID);
+ * avr_uart_record_u16(adc);
+ * avr_uart_record_u32(millis);
+ * avr_uart_record_float(temp);
+ * avr_uart_record_end();
+ * @endcode
+ */
+void avr_uart_record_begin(void);
+
+/**
+ * @brief Append len bytes to the record
+ *
+ * @param data Bytes to append
+ * @param len Number of bytes
+ */
+void avr_uart_record_bytes(const void *data, size_t len);
+
+/**
+ * @brief Append an 8-bit field to the record
+ */
+void avr_uart_record_u8(uint8_t u);
+
+/**
+ * @brief Append a 16-bit field to the record, low byte first
+ */
+void avr_uart_record_u16(uint16_t u);
+
+/**
+ * @brief Append a 32-bit field to the record, low byte first
+ */
+void avr_uart_record_u32(uint32_t u);
+
+/**
+ * @brief Append an IEEE 754 single precision field to the record, low
+ *        byte first
+ */
+void avr_uart_record_float(float f);
+
+/**
+ * @brief Append the CRC trailer and send the record
+ *
+ * Waits for transmit buffer space as needed.
+ */
+void avr_uart_record_end(void);
+
+#endif /* UART_HAS_TX */
+
+#if UART_HAS_RX
+
+/**
+ * @brief Set the length of received records
+ *
+ * The receive buffer is flushed, the next byte received starts a record.
+ * Every record is len bytes followed by the CRC trailer, records lose their
+ * boundaries if the peer was already part way through one. Calling it again
+ * while the peer is idle resynchronises the record boundaries.
+ *
+ * @param len Record length without the CRC trailer, 0 hands the receive
+ *            buffer back to avr_uart_recv() and friends
+ * @return 1 on success, 0 if the record and its trailer do not fit the
+ *         receive buffer
+ */
+uint8_t avr_uart_record_length(size_t len);
+
+/**
+ * @brief Get the number of complete records waiting in the receive buffer
+ *
+ * @return Number of records that avr_uart_record_recv() returns
+ */
+uint8_t avr_uart_record_available(void);
+
+/**
+ * @brief Receive one complete record
+ *
+ * Copies the oldest complete record without its CRC trailer into buf and
+ * removes it from the receive buffer. The CRC was already checked by the RX
+ * ISR as the bytes arrived. Returns at once when no record is complete.
+ *
+ * @param buf Buffer to receive the record
+ * @param len Size of buf
+ * @return Record length, UART_RECORD_NONE if no record is complete, or
+ *         UART_RECORD_ERROR if the record failed its CRC, lost bytes to a
+ *         full receive buffer or record queue, or does not fit buf
+ *
+ * @code
+ * struct sample s;
+ * avr_uart_record_length(sizeof(s));
+ * ...
+ * if (avr_uart_record_recv(&s, sizeof(s)) == sizeof(s)) {
+ *     log_sample(&s);
+ * }
+ * @endcode
+ */
+size_t avr_uart_record_recv(void *buf, size_t len);
+
+#endif /* UART_HAS_RX */
+
+#endif /* _AVR_UART_RECORD_H_ */
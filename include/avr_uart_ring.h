@@ -0,0 +1,163 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_RING_H_
+#define _AVR_UART_RING_H_
+
+/**
+ * @file avr_uart_ring.h
+ * @author notweerdmonk
+ * @brief Ring buffer helpers shared by the UART drivers
+ *
+ * Index types, index arithmetic, ISR-safe accesses and the blocking wait
+ * used by avr_uart.c and by the additional ports of avr_uart_multi.h, so
+ * that both drivers behave the same.
+ *
+ * @internal
+ */
+
+#include <stdint.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#ifdef AVR_UART_SLEEP
+#include <avr/sleep.h>
+#endif
+
+/**
+ * @internal
+ * @brief Smallest unsigned type holding n
+ *
+ * Count types have to hold a buffer length itself, index types only have
+ * to hold the length - 1. Default lengths are enumerators which the
+ * preprocessor cannot evaluate, so the type is chosen by the compiler.
+ */
+#define UART_SIZE_TYPE(n)                                        \
+  __typeof__(__builtin_choose_expr((n) <= 0xff, (uint8_t)0,      \
+        __builtin_choose_expr((n) <= 0xffff, (uint16_t)0,        \
+          (uint32_t)0)))
+
+/*
+ * Ring index arithmetic. Power of two buffer lengths wrap by masking, other
+ * lengths compare and reset. The condition folds at compile time.
+ */
+#define UART_IS_POWER_OF_TWO(n) (((n) & ((n) - 1)) == 0)
+
+/**
+ * @internal
+ * @brief Wrap an index that is at most one length past the end
+ */
+#define UART_RING_WRAP(i, len)                                   \
+  (UART_IS_POWER_OF_TWO(len) ? (i) & ((len) - 1) :               \
+   (i) >= (len) ? (i) - (len) : (i))
+
+/**
+ * @internal
+ * @brief Index following i
+ */
+#define UART_RING_NEXT(i, len) UART_RING_WRAP((i) + 1, len)
+
+/**
+ * @internal
+ * @brief Bytes between out and in of a ring that keeps one slot empty
+ */
+#define UART_RING_COUNT(in, out, len) \
+  ((in) >= (out) ? (in) - (out) : (len) - (out) + (in))
+
+/*
+ * Single byte accesses are atomic on AVR. Counts and indices wider than a byte
+ * that are shared with an ISR are accessed with interrupts disabled.
+ */
+#define UART_ATOMIC_LOAD(v)                  \
+  ({                                         \
+    __typeof__(v) __v;                       \
+    if (sizeof(v) > 1) {                     \
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {    \
+        __v = (v);                           \
+      }                                      \
+    } else {                                 \
+      __v = (v);                             \
+    }                                        \
+    __v;                                     \
+  })
+
+#define UART_ATOMIC_STORE(v, x)              \
+  do {                                       \
+    if (sizeof(v) > 1) {                     \
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {    \
+        (v) = (x);                           \
+      }                                      \
+    } else {                                 \
+      (v) = (x);                             \
+    }                                        \
+  } while (0)
+
+/*
+ * A register outside the sbi/cbi range, such as UCSRnB, is set bit by bit
+ * with a load, a change and a store. ISRs that set bits of it in between
+ * would be undone by the store, so the main loop changes it atomically.
+ */
+#define UART_ATOMIC_RMW(op)                  \
+  do {                                       \
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {      \
+      op;                                    \
+    }                                        \
+  } while (0)
+
+/*
+ * Blocking calls wait for the ISRs with UART_WAIT_WHILE. With AVR_UART_SLEEP
+ * the CPU idles between checks, the condition is tested with interrupts
+ * disabled and sleep_cpu directly follows sei, so an interrupt arriving
+ * after the test still ends the sleep. The caller's interrupt state is
+ * restored once the condition clears. A caller with interrupts disabled,
+ * e.g. inside an ATOMIC_BLOCK, would never be woken, so it spins instead.
+ */
+#ifdef AVR_UART_SLEEP
+
+#define UART_WAIT_WHILE(cond)                \
+  do {                                       \
+    uint8_t __sreg = SREG;                   \
+    set_sleep_mode(SLEEP_MODE_IDLE);         \
+    for (;;) {                               \
+      cli();                                 \
+      if (!(cond)) {                         \
+        break;                               \
+      }                                      \
+      if (!(__sreg & _BV(SREG_I))) {         \
+        continue;                            \
+      }                                      \
+      sleep_enable();                        \
+      sei();                                 \
+      sleep_cpu();                           \
+      sleep_disable();                       \
+    }                                        \
+    SREG = __sreg;                           \
+  } while (0)
+
+#else /* !AVR_UART_SLEEP */
+
+#define UART_WAIT_WHILE(cond) while (cond)
+
+#endif /* AVR_UART_SLEEP */
+
+#endif /* _AVR_UART_RING_H_ */
@@ -36,6 +36,125 @@
 #include <avr_portable.h>
 #include <avr_ascii.h>
 #include <util/delay.h>
+#include <util/atomic.h>
+#include <avr_uart_ring.h>
+#include "avr_uart_fmt.h"
+
+/*
+ * Registers and bits the port layer does not abstract. The fallbacks match
+ * USART0 of the ATmega328P.
+ */
+#ifndef PORT_UCSRA
+#define PORT_UCSRA UCSR0A
+#endif
+#ifndef PORT_DOR
+#define PORT_DOR DOR0
+#endif
+#ifndef PORT_FE
+#define PORT_FE FE0
+#endif
+#ifndef PORT_UPE
+#define PORT_UPE UPE0
+#endif
+#ifndef PORT_UCSRB
+#define PORT_UCSRB UCSR0B
+#endif
+#ifndef PORT_TXCIE
+#define PORT_TXCIE TXCIE0
+#endif
+#ifndef PORT_TXC
+#define PORT_TXC TXC0
+#endif
+#ifndef PORT_MPCM
+#define PORT_MPCM MPCM0
+#endif
+#ifndef PORT_TXC_VECT
+#define PORT_TXC_VECT USART_TX_vect
+#endif
+#ifndef PORT_UBRR
+#define PORT_UBRR UBRR0
+#endif
+#ifndef PORT_U2X
+#define PORT_U2X U2X0
+#endif
+#ifndef PORT_RXEN
+#define PORT_RXEN RXEN0
+#endif
+#ifndef PORT_RXCIE
+#define PORT_RXCIE RXCIE0
+#endif
+#ifndef PORT_TXEN
+#define PORT_TXEN TXEN0
+#endif
+#ifndef PORT_RXD_PIN
+#define PORT_RXD_PIN PIND
+#endif
+#ifndef PORT_RXD_BIT
+#define PORT_RXD_BIT PD0
+#endif
+
+#if defined AVR_UART_FRAME && \
+  (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+#error UART_RX_OVERFLOW_DROP_OLDEST would overwrite queued frames, \
+  use it without AVR_UART_FRAME
+#endif
+
+#if defined AVR_UART_SPSC && \
+  (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+#error UART_RX_OVERFLOW_DROP_OLDEST needs the RXC ISR to move rx_out, \
+  which AVR_UART_SPSC leaves to the main loop
+#endif
+
+#if defined AVR_UART_LINE && \
+  (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+#error UART_RX_OVERFLOW_DROP_OLDEST would overwrite queued lines, \
+  use it without AVR_UART_LINE
+#endif
+
+#if defined AVR_UART_LINE && defined AVR_UART_FRAME
+#error AVR_UART_LINE and AVR_UART_FRAME both own the RX buffer, \
+  enable one of them
+#endif
+
+#if defined AVR_UART_RECORD && UART_HAS_RX && \
+  (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+#error UART_RX_OVERFLOW_DROP_OLDEST would overwrite queued records, \
+  use it without AVR_UART_RECORD
+#endif
+
+#if defined AVR_UART_RECORD && \
+  (defined AVR_UART_FRAME || defined AVR_UART_LINE)
+#error AVR_UART_RECORD and AVR_UART_FRAME or AVR_UART_LINE both own the \
+  RX buffer, enable one of them
+#endif
+
+#if defined AVR_UART_RECORD && defined AVR_UART_XONXOFF
+#error AVR_UART_XONXOFF takes XON and XOFF bytes out of the received \
+  records and the peer reads them in sent ones, use AVR_UART_RTSCTS
+#endif
+
+#if defined AVR_UART_NOBLOCK_MATCH && !defined AVR_UART_MATCH
+#error AVR_UART_NOBLOCK_MATCH defers pattern matching, \
+  use it with AVR_UART_MATCH
+#endif
+
+#if !UART_HAS_RX && (defined AVR_UART_MATCH || defined AVR_UART_FRAME || \
+  defined AVR_UART_AUTOBAUD)
+#error AVR_UART_TX_ONLY leaves out the receive side that AVR_UART_MATCH, \
+  AVR_UART_FRAME and AVR_UART_AUTOBAUD work on
+#endif
+
+#if !UART_HAS_TX && (defined AVR_UART_PRINTF || defined AVR_UART_TX_DESC || \
+  defined AVR_UART_TX_WATERMARK || defined AVR_UART_RS485)
+#error AVR_UART_RX_ONLY leaves out the transmit side that AVR_UART_PRINTF, \
+  AVR_UART_TX_DESC, AVR_UART_TX_WATERMARK and AVR_UART_RS485 work on
+#endif
+
+#if !(UART_HAS_RX && UART_HAS_TX) && (defined AVR_UART_RTSCTS || \
+  defined AVR_UART_XONXOFF || defined AVR_UART_LINE)
+#error AVR_UART_RTSCTS, AVR_UART_XONXOFF and AVR_UART_LINE need both \
+  directions, use them without AVR_UART_TX_ONLY and AVR_UART_RX_ONLY
+#endif
 
 
 /* FIFO buffered UART for AVR family of microcontrollers. */
@@ -44,6 +163,21 @@
 /* Variables */
 /*****************************************************************************/
 
+#ifdef AVR_UART_PROFILE
+
+/**
+ * @internal
+ * @brief Running minimum, maximum and sum of a duration in cycles
+ */
+struct _uart_timing {
+  uint32_t min;
+  uint32_t max;
+  uint32_t sum;
+  uint32_t count;
+};
+
+#endif /* AVR_UART_PROFILE */
+
 /**
  * @brief UART internal state structure
  *
@@ -53,398 +187,2581 @@
 static
 struct _uart {
 
-#undef RX_COUNT_SIZE_TYPE
-#if (UART_RX_BUFFER_LEN < 256)
-#define RX_COUNT_SIZE_TYPE uint8_t
-#elif (UART_RX_BUFFER_LEN < 65536)
-#define RX_COUNT_SIZE_TYPE uint16_t
-#elif (UART_RX_BUFFER_LEN < 4294967296)
-#define RX_COUNT_SIZE_TYPE uint32_t
-#else
-#error UART_RX_BUFFER_LEN too large
-#endif
+/* Count types hold UART_*_BUFFER_LEN, index types UART_*_BUFFER_LEN - 1 */
+#undef RX_COUNT_SIZE_TYPE
+#define RX_COUNT_SIZE_TYPE UART_SIZE_TYPE(UART_RX_BUFFER_LEN)
+#undef RX_INDEX_SIZE_TYPE
+#define RX_INDEX_SIZE_TYPE UART_SIZE_TYPE(UART_RX_BUFFER_LEN - 1)
+
+#undef TX_COUNT_SIZE_TYPE
+#define TX_COUNT_SIZE_TYPE UART_SIZE_TYPE(UART_TX_BUFFER_LEN)
+#undef TX_INDEX_SIZE_TYPE
+#define TX_INDEX_SIZE_TYPE UART_SIZE_TYPE(UART_TX_BUFFER_LEN - 1)
+
+#if UART_HAS_RX
+ char rx_buffer[UART_RX_BUFFER_LEN];
+#endif
+#if UART_HAS_TX
+ char tx_buffer[UART_TX_BUFFER_LEN];
+#endif
+
+#ifdef AVR_UART_SPSC
+
+ /*
+  * The RXC ISR is the only writer of rx_in and the main loop is the only
+  * writer of rx_out, the other way around for tx_in and tx_out. Fill levels
+  * are computed from the indices, one slot of each ring is kept empty to tell
+  * a full ring from an empty one.
+  */
+ volatile RX_INDEX_SIZE_TYPE rx_in;
+ volatile RX_INDEX_SIZE_TYPE rx_out;
+
+ volatile TX_INDEX_SIZE_TYPE tx_in;
+ volatile TX_INDEX_SIZE_TYPE tx_out;
+
+#else /* !AVR_UART_SPSC */
+
+ volatile RX_COUNT_SIZE_TYPE rx_count;
+ volatile TX_COUNT_SIZE_TYPE tx_count;
+
+ RX_INDEX_SIZE_TYPE rx_in;
+ RX_INDEX_SIZE_TYPE rx_out;
+
+ TX_INDEX_SIZE_TYPE tx_in;
+ TX_INDEX_SIZE_TYPE tx_out;
+
+#endif /* AVR_UART_SPSC */
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
+ volatile uint8_t rx_error;
+#endif
+
+#ifdef AVR_UART_STATS
+ struct avr_uart_stats stats;
+#endif
+
+#if defined AVR_UART_RTSCTS || defined AVR_UART_XONXOFF
+ /* The RX ISR stopped the peer at the high watermark */
+ volatile uint8_t rx_stopped;
+#endif
+
+#ifdef AVR_UART_XONXOFF
+ /* XON or XOFF for the UDRE ISR to send ahead of the TX ring */
+ volatile uint8_t tx_ctrl;
+ /* The peer sent XOFF */
+ volatile uint8_t tx_stopped;
+#endif
+
+#if defined AVR_UART_RUNTIME_CONFIG || defined AVR_UART_AUTOBAUD
+ /* Requested baud rate, the error is reported against it */
+ uint32_t baud;
+#endif
+
+#ifdef AVR_UART_LINE
+ /* Echo of line input for the UDRE ISR to send ahead of the TX ring */
+ char echo[UART_ECHO_LEN];
+ volatile uint8_t echo_in;
+ volatile uint8_t echo_out;
+#endif
+
+#ifdef AVR_UART_NOBLOCK_MATCH
+ /*
+  * Received bytes the matcher has not seen yet. Only the RXC ISR touches
+  * them, always with interrupts disabled.
+  */
+ uint8_t match_queue[UART_MATCH_QUEUE_LEN + 1];
+ uint8_t match_in;
+ uint8_t match_out;
+ /* An RXC ISR is matching with interrupts enabled */
+ uint8_t match_busy;
+#endif
+
+#ifdef AVR_UART_PROFILE
+ struct {
+   struct _uart_timing rx_isr;
+   struct _uart_timing udre_isr;
+   struct _uart_timing tx_latency;
+   /* Timer1 overflows, the high word of the latency timestamps */
+   volatile uint16_t overflows;
+   /* One TX byte at a time is followed from enqueue to UDR */
+   volatile uint8_t tx_pending;
+   TX_INDEX_SIZE_TYPE tx_mark;
+   uint32_t tx_time;
+ } profile;
+#endif
+
+#ifdef AVR_UART_TX_DESC
+ /* Blocks the UDRE ISR sends straight from RAM or flash */
+ struct _uart_tx_desc {
+   const char *data;
+   size_t len;
+   /* tx_out once the ring bytes queued ahead of the block are sent */
+   TX_INDEX_SIZE_TYPE marker;
+   uint8_t pgm;
+   avr_uart_tx_handler done;
+   void *done_data;
+ } tx_desc[UART_TX_DESC_QUEUE_LEN];
+ volatile uint8_t tx_desc_count;
+ uint8_t tx_desc_in;
+ uint8_t tx_desc_out;
+#endif
+
+#ifdef AVR_UART_TX_WATERMARK
+ /* The UDRE ISR calls tx_wake_handler when the fill level drops to this */
+ TX_COUNT_SIZE_TYPE tx_wake_count;
+ avr_uart_tx_handler tx_wake_handler;
+ void *tx_wake_data;
+#endif
+
+} uart;
+
+#define RX_INDEX_WRAP(i) UART_RING_WRAP(i, UART_RX_BUFFER_LEN)
+#define TX_INDEX_WRAP(i) UART_RING_WRAP(i, UART_TX_BUFFER_LEN)
+
+#define RX_INDEX_NEXT(i) RX_INDEX_WRAP((i) + 1)
+#define TX_INDEX_NEXT(i) TX_INDEX_WRAP((i) + 1)
+
+_Static_assert(UART_RX_BUFFER_LEN > 0 && UART_TX_BUFFER_LEN > 0,
+    "UART buffer lengths must be non-zero");
+_Static_assert((RX_INDEX_SIZE_TYPE)(UART_RX_BUFFER_LEN - 1) ==
+    UART_RX_BUFFER_LEN - 1, "RX_INDEX_SIZE_TYPE cannot index rx_buffer");
+_Static_assert((RX_COUNT_SIZE_TYPE)UART_RX_BUFFER_LEN == UART_RX_BUFFER_LEN,
+    "RX_COUNT_SIZE_TYPE cannot count rx_buffer");
+_Static_assert((TX_INDEX_SIZE_TYPE)(UART_TX_BUFFER_LEN - 1) ==
+    UART_TX_BUFFER_LEN - 1, "TX_INDEX_SIZE_TYPE cannot index tx_buffer");
+_Static_assert((TX_COUNT_SIZE_TYPE)UART_TX_BUFFER_LEN == UART_TX_BUFFER_LEN,
+    "TX_COUNT_SIZE_TYPE cannot count tx_buffer");
+
+#ifdef AVR_UART_TIMEOUT
+
+/**
+ * @internal
+ * @brief Deadline of a timed wait
+ *
+ * With UART_TIMEOUT_TICKS the deadline is measured on the application tick
+ * source. Without it each check is followed by a short busy delay and the
+ * delays are counted into 1 ms ticks. The delays leave out the cycles of the
+ * checks between them and the time spent in interrupts, so these ticks run
+ * long.
+ */
+struct _uart_timer {
+  uint16_t ticks;
+#ifdef UART_TIMEOUT_TICKS
+  uint16_t start;
+#else
+  uint8_t polls;
+#endif
+};
+
+#ifdef UART_TIMEOUT_TICKS
+
+extern uint16_t UART_TIMEOUT_TICKS(void);
+
+static inline void uart_timer_start(struct _uart_timer *t,
+    uint16_t timeout) {
+  t->ticks = timeout;
+  t->start = UART_TIMEOUT_TICKS();
+}
+
+static inline uint8_t uart_timer_expired(struct _uart_timer *t) {
+  return (uint16_t)(UART_TIMEOUT_TICKS() - t->start) >= t->ticks;
+}
+
+/* The tick interrupt ends an idle sleep, so timed waits may sleep too */
+#define UART_WAIT_WHILE_TIMED(cond, t) \
+  UART_WAIT_WHILE((cond) && !uart_timer_expired(t))
+
+#else /* !UART_TIMEOUT_TICKS */
+
+/*
+ * Busy delay between checks of a timed wait, a divisor of 1000 and at least
+ * about 400 cycles. A check and the tick count take some 20 cycles, counted
+ * from the loop, so a tick runs up to 5 % long, 8 % below 2 MHz.
+ */
+#if F_CPU >= 16000000UL
+#define UART_TIMEOUT_POLL_US 25
+#elif F_CPU >= 8000000UL
+#define UART_TIMEOUT_POLL_US 50
+#elif F_CPU >= 4000000UL
+#define UART_TIMEOUT_POLL_US 100
+#elif F_CPU >= 2000000UL
+#define UART_TIMEOUT_POLL_US 200
+#else
+#define UART_TIMEOUT_POLL_US 250
+#endif
+
+static inline void uart_timer_start(struct _uart_timer *t,
+    uint16_t timeout) {
+  t->ticks = timeout;
+  t->polls = 0;
+}
+
+static inline uint8_t uart_timer_expired(struct _uart_timer *t) {
+  if (t->ticks == 0) {
+    return 1;
+  }
+  _delay_us(UART_TIMEOUT_POLL_US);
+  if (++t->polls == 1000 / UART_TIMEOUT_POLL_US) {
+    t->polls = 0;
+    t->ticks--;
+  }
+  return 0;
+}
+
+/* Nothing would end an idle sleep at the deadline */
+#define UART_WAIT_WHILE_TIMED(cond, t) \
+  while ((cond) && !uart_timer_expired(t))
+
+#endif /* UART_TIMEOUT_TICKS */
+
+#endif /* AVR_UART_TIMEOUT */
+
+#ifdef AVR_UART_PROFILE
+
+/*
+ * ISR profiling. Timer1 runs free at F_CPU, the ISRs take its count after
+ * their prologue and before their epilogue, which therefore are not part of
+ * the durations. A TX byte is stamped when it is enqueued and again when the
+ * UDRE ISR writes it to UDR, with the overflow count as the high word so the
+ * wait for a full ring fits.
+ */
+
+static inline void uart_timing_add(struct _uart_timing *t, uint32_t cycles) {
+
+  if (t->count == 0 || cycles < t->min) {
+    t->min = cycles;
+  }
+  if (cycles > t->max) {
+    t->max = cycles;
+  }
+
+  /* Halving keeps the average once the sum would overflow */
+  if (t->sum > UINT32_MAX - cycles) {
+    t->sum >>= 1;
+    t->count >>= 1;
+  }
+  t->sum += cycles;
+  t->count++;
+}
+
+/**
+ * @internal
+ * @brief Timer1 count extended by the overflow count
+ *
+ * @note Call with interrupts disabled
+ */
+static inline uint32_t uart_profile_now(void) {
+
+  uint16_t low = TCNT1;
+  uint16_t high = uart.profile.overflows;
+
+  /* An overflow the ISR has not counted yet */
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+    high++;
+  }
+
+  return (uint32_t)high << 16 | low;
+}
+
+/**
+ * @internal
+ * @brief Stamp the byte ending at tx_in unless one is being followed
+ *
+ * @note Called before tx_in is published, the UDRE ISR cannot pass it yet
+ */
+static inline void uart_profile_tx_enqueued(TX_INDEX_SIZE_TYPE tx_in) {
+
+  if (!uart.profile.tx_pending) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      uart.profile.tx_mark = tx_in;
+      uart.profile.tx_time = uart_profile_now();
+      uart.profile.tx_pending = 1;
+    }
+  }
+}
+
+/**
+ * @internal
+ * @brief Record the latency once the stamped byte went to UDR
+ *
+ * @param tx_out tx_out after the byte just written to UDR
+ */
+static inline void uart_profile_tx_sent(TX_INDEX_SIZE_TYPE tx_out) {
+
+  if (uart.profile.tx_pending && tx_out == uart.profile.tx_mark) {
+    uart_timing_add(&uart.profile.tx_latency,
+        uart_profile_now() - uart.profile.tx_time);
+    uart.profile.tx_pending = 0;
+  }
+}
+
+#define UART_PROFILE_START() uint16_t uart_profile_start = TCNT1
+#define UART_PROFILE_STOP(timing) \
+  uart_timing_add(&uart.profile.timing, (uint16_t)(TCNT1 - uart_profile_start))
+
+#else /* !AVR_UART_PROFILE */
+
+#define uart_profile_tx_enqueued(tx_in)
+#define uart_profile_tx_sent(tx_out)
+#define UART_PROFILE_START()
+#define UART_PROFILE_STOP(timing)
+
+#endif /* AVR_UART_PROFILE */
+
+#ifdef AVR_UART_PROFILE_PINS
+/* Single bit I/O port writes, safe from nested updates */
+#define UART_PROFILE_PIN_SET(bit)   (UART_PROFILE_PORT |= _BV(bit))
+#define UART_PROFILE_PIN_CLEAR(bit) (UART_PROFILE_PORT &= ~_BV(bit))
+#else
+#define UART_PROFILE_PIN_SET(bit)
+#define UART_PROFILE_PIN_CLEAR(bit)
+#endif
+
+/* An ISR raises its pin and starts timing first, and stops both last */
+#define UART_PROFILE_BEGIN(bit) \
+  UART_PROFILE_PIN_SET(bit);    \
+  UART_PROFILE_START()
+#define UART_PROFILE_END(bit, timing) \
+  UART_PROFILE_PIN_CLEAR(bit);        \
+  UART_PROFILE_STOP(timing)
+
+#ifdef AVR_UART_RS485
+
+/**
+ * @internal
+ * @brief Clear a TXC flag left over from an earlier byte
+ *
+ * TXC is cleared by writing one to it. U2X and MPCM are written back as
+ * they are and the error flags are written zero, as the datasheet asks.
+ */
+static inline void uart_rs485_txc_clear(void) {
+  PORT_UCSRA = (PORT_UCSRA & (_BV(PORT_U2X) | _BV(PORT_MPCM))) |
+    _BV(PORT_TXC);
+}
+
+/*
+ * The driver enable pin is raised once bytes are in the TX ring and dropped
+ * by the TXC ISR after the stop bit of the last one. Other bits of the port
+ * register may be changed by ISRs, so it is updated with interrupts off.
+ * A stale TXC is cleared first so that its ISR cannot drop the pin under the
+ * bytes about to be sent.
+ */
+static inline void uart_rs485_tx_begin(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uart_rs485_txc_clear();
+    UART_RS485_DE_PORT |= _BV(UART_RS485_DE_BIT);
+  }
+}
+
+/*
+ * UDRE outranks TXC, so a TXC of the byte before could otherwise be taken
+ * after a later UDRE ISR emptied the ring, with the last byte still in the
+ * shift register. Cleared after the write, while UDR is full TXC cannot be
+ * set again until the new byte has gone out.
+ */
+#define UART_UDR_WRITE(c)    \
+  do {                       \
+    PORT_UDR = (c);          \
+    uart_rs485_txc_clear();  \
+  } while (0)
+
+static inline uint8_t uart_rs485_busy(void) {
+  return (UART_RS485_DE_PORT & _BV(UART_RS485_DE_BIT)) != 0;
+}
+
+#else /* !AVR_UART_RS485 */
+
+#define uart_rs485_tx_begin()
+#define UART_UDR_WRITE(c) (PORT_UDR = (c))
+
+#endif /* AVR_UART_RS485 */
+
+#if defined AVR_UART_RTSCTS || defined AVR_UART_XONXOFF
+static inline void uart_rx_flow_resume(void);
+#else
+#define uart_rx_flow_resume()
+#endif
+
+/*
+ * The RX, CTS and UDRE ISRs set and clear UDRIE, so the main loop masks and
+ * unmasks interrupts in UCSRnB atomically. Otherwise an XOFF, an echo or a
+ * CTS restart raised between the load and the store of UCSRnB is lost.
+ */
+#define UART_RXC_MASK()   UART_ATOMIC_RMW(PORT_DISABLE_RXC_INTERRUPT())
+#define UART_RXC_UNMASK() UART_ATOMIC_RMW(PORT_ENABLE_RXC_INTERRUPT())
+#define UART_UDRE_UNMASK() UART_ATOMIC_RMW(PORT_ENABLE_UDRE_INTERRUPT())
+
+#ifdef AVR_UART_SPSC
+
+/* Number of bytes the rings can hold */
+#define UART_RX_CAPACITY (UART_RX_BUFFER_LEN - 1)
+#define UART_TX_CAPACITY (UART_TX_BUFFER_LEN - 1)
+
+/**
+ * @internal
+ * @brief Number of bytes waiting in the RX ring
+ */
+static inline RX_COUNT_SIZE_TYPE uart_rx_count(void) {
+  RX_COUNT_SIZE_TYPE rx_in = UART_ATOMIC_LOAD(uart.rx_in);
+  RX_COUNT_SIZE_TYPE rx_out = uart.rx_out;
+  return UART_RING_COUNT(rx_in, rx_out, UART_RX_BUFFER_LEN);
+}
+
+/**
+ * @internal
+ * @brief Number of bytes waiting in the TX ring
+ */
+static inline TX_COUNT_SIZE_TYPE uart_tx_count(void) {
+  TX_COUNT_SIZE_TYPE tx_in = uart.tx_in;
+  TX_COUNT_SIZE_TYPE tx_out = UART_ATOMIC_LOAD(uart.tx_out);
+  return UART_RING_COUNT(tx_in, tx_out, UART_TX_BUFFER_LEN);
+}
+
+/**
+ * @internal
+ * @brief Release n bytes read from the RX ring, rx_out becomes the new index
+ */
+static inline void uart_rx_consume(RX_INDEX_SIZE_TYPE rx_out,
+    RX_COUNT_SIZE_TYPE n) {
+  (void)n;
+  UART_ATOMIC_STORE(uart.rx_out, rx_out);
+  uart_rx_flow_resume();
+}
+
+/**
+ * @internal
+ * @brief Publish n bytes written into the TX ring, tx_in becomes the new index
+ */
+static inline void uart_tx_produce(TX_INDEX_SIZE_TYPE tx_in,
+    TX_COUNT_SIZE_TYPE n) {
+  (void)n;
+  uart_profile_tx_enqueued(tx_in);
+  UART_ATOMIC_STORE(uart.tx_in, tx_in);
+  uart_rs485_tx_begin();
+  UART_UDRE_UNMASK();
+}
+
+#else /* !AVR_UART_SPSC */
+
+#define UART_RX_CAPACITY UART_RX_BUFFER_LEN
+#define UART_TX_CAPACITY UART_TX_BUFFER_LEN
+
+static inline RX_COUNT_SIZE_TYPE uart_rx_count(void) {
+  return UART_ATOMIC_LOAD(uart.rx_count);
+}
+
+static inline TX_COUNT_SIZE_TYPE uart_tx_count(void) {
+  return UART_ATOMIC_LOAD(uart.tx_count);
+}
+
+static inline void uart_rx_consume(RX_INDEX_SIZE_TYPE rx_out,
+    RX_COUNT_SIZE_TYPE n) {
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+
+  /* Reader already holds the RXC interrupt off, see UART_RX_READ_BEGIN */
+  uart.rx_count -= n;
+  uart.rx_out = rx_out;
+
+#else
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uart.rx_count -= n;
+    uart.rx_out = rx_out;
+  }
+
+#endif
+
+  uart_rx_flow_resume();
+}
+
+static inline void uart_tx_produce(TX_INDEX_SIZE_TYPE tx_in,
+    TX_COUNT_SIZE_TYPE n) {
+
+  /*
+   * Masking UDRIE alone is not enough, the RX and CTS ISRs set it again and
+   * the UDRE ISR would then run between the load and the store of tx_count
+   */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uart_profile_tx_enqueued(tx_in);
+    uart.tx_count += n;
+    uart.tx_in = tx_in;
+
+    /* Raised after the count, a TXC ISR in between then keeps the pin high */
+    uart_rs485_tx_begin();
+
+    PORT_ENABLE_UDRE_INTERRUPT();
+  }
+}
+
+#endif /* AVR_UART_SPSC */
+
+#ifdef AVR_UART_TX_DESC
+
+/*
+ * TX descriptors. Each block remembers the tx_in of the moment it was queued,
+ * the UDRE ISR sends the ring up to that index, then the block, then goes on
+ * with the ring. Bytes queued later therefore follow the block.
+ */
+
+static inline uint8_t uart_tx_desc_pending(void) {
+  return UART_ATOMIC_LOAD(uart.tx_desc_count) != 0;
+}
+
+/**
+ * @internal
+ * @brief Send the next byte of the head block once the ring reached it
+ *
+ * @return 1 if a byte was written to UDR, 0 if the ring goes first
+ *
+ * @note Called from the UDRE ISR
+ */
+static inline uint8_t uart_tx_desc_send(void) {
+
+  if (uart.tx_desc_count == 0) {
+    return 0;
+  }
+
+  struct _uart_tx_desc *desc = &uart.tx_desc[uart.tx_desc_out];
+
+  if (desc->marker != uart.tx_out) {
+    return 0;
+  }
+
+  UART_UDR_WRITE(desc->pgm ? pgm_read_byte(desc->data) : *desc->data);
+  desc->data++;
+
+#ifdef AVR_UART_STATS
+  uart.stats.tx_bytes++;
+#endif
+
+  if (--desc->len == 0) {
+    avr_uart_tx_handler done = desc->done;
+    void *done_data = desc->done_data;
+
+    uart.tx_desc_out = uart.tx_desc_out + 1 == UART_TX_DESC_QUEUE_LEN ?
+      0 : uart.tx_desc_out + 1;
+
+    if (--uart.tx_desc_count == 0 && uart_tx_count() == 0) {
+      PORT_DISABLE_UDRE_INTERRUPT();
+    }
+
+    /* The block is in UDR, its buffer may be reused */
+    if (done) {
+      (*done)(done_data);
+    }
+  }
+
+  return 1;
+}
+
+#else /* !AVR_UART_TX_DESC */
+
+#define uart_tx_desc_pending() 0
+
+#endif /* AVR_UART_TX_DESC */
+
+#ifdef AVR_UART_LINE
+
+_Static_assert(UART_ECHO_LEN >= 2 && UART_ECHO_LEN <= 256 &&
+    (UART_ECHO_LEN & (UART_ECHO_LEN - 1)) == 0,
+    "UART_ECHO_LEN must be a power of two between 2 and 256");
+
+#define ECHO_INDEX_NEXT(i) ((uint8_t)((i) + 1) & (UART_ECHO_LEN - 1))
+
+static inline uint8_t uart_echo_pending(void) {
+  return uart.echo_in != uart.echo_out;
+}
+
+/**
+ * @internal
+ * @brief Send the next echo byte
+ *
+ * @return 1 if a byte was written to UDR
+ *
+ * @note Called from the UDRE ISR
+ */
+static inline uint8_t uart_echo_send(void) {
+
+  uint8_t out = uart.echo_out;
+
+  if (out == uart.echo_in) {
+    return 0;
+  }
+
+  UART_UDR_WRITE(uart.echo[out]);
+  uart.echo_out = out = ECHO_INDEX_NEXT(out);
+
+#ifdef AVR_UART_STATS
+  uart.stats.tx_bytes++;
+#endif
+
+  if (out == uart.echo_in && uart_tx_count() == 0 &&
+      !uart_tx_desc_pending()) {
+    PORT_DISABLE_UDRE_INTERRUPT();
+  }
+
+  return 1;
+}
+
+#else /* !AVR_UART_LINE */
+
+#define uart_echo_pending() 0
+
+#endif /* AVR_UART_LINE */
+
+/**
+ * @internal
+ * @brief Nothing is left for the UDRE ISR to send
+ */
+static inline uint8_t uart_tx_idle(void) {
+  return uart_tx_count() == 0 && !uart_tx_desc_pending() &&
+    !uart_echo_pending();
+}
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+
+/*
+ * Dropping the oldest byte moves rx_out from the RXC ISR, so readers keep the
+ * interrupt masked from taking rx_out until they have released the bytes.
+ */
+#define UART_RX_READ_BEGIN() UART_RXC_MASK()
+#define UART_RX_READ_END()   UART_RXC_UNMASK()
+
+#else
+
+#define UART_RX_READ_BEGIN()
+#define UART_RX_READ_END()
+
+#endif
+
+#if defined AVR_UART_RTSCTS || defined AVR_UART_XONXOFF
+
+/*
+ * Receive flow control. The RX ISR stops the peer once the RX ring fills to
+ * UART_RX_HIGH_WATER, the reader lets it go on once reads drain the ring to
+ * UART_RX_LOW_WATER. RTS is driven high to stop and low to go, XOFF and XON
+ * are sent by the UDRE ISR ahead of the bytes in the TX ring.
+ */
+
+_Static_assert(UART_RX_LOW_WATER < UART_RX_HIGH_WATER &&
+    UART_RX_HIGH_WATER <= UART_RX_CAPACITY,
+    "UART_RX_LOW_WATER and UART_RX_HIGH_WATER do not fit the RX buffer");
+
+static inline void uart_rx_flow_set(uint8_t stop) {
+
+  uart.rx_stopped = stop;
+
+#ifdef AVR_UART_RTSCTS
+  if (stop) {
+    UART_RTS_PORT |= _BV(UART_RTS_BIT);
+  } else {
+    UART_RTS_PORT &= ~_BV(UART_RTS_BIT);
+  }
+#endif
+
+#ifdef AVR_UART_XONXOFF
+  uart.tx_ctrl = stop ? UART_XOFF : UART_XON;
+  uart_rs485_tx_begin();
+  PORT_ENABLE_UDRE_INTERRUPT();
+#endif
+}
+
+/**
+ * @internal
+ * @brief Stop the peer at the high watermark, called from the RX ISR
+ */
+static inline void uart_rx_flow_check(void) {
+  if (!uart.rx_stopped && uart_rx_count() >= UART_RX_HIGH_WATER) {
+    uart_rx_flow_set(1);
+  }
+}
+
+/**
+ * @internal
+ * @brief Let the peer go on at the low watermark, called by readers
+ */
+static inline void uart_rx_flow_resume(void) {
+  if (uart.rx_stopped) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (uart_rx_count() <= UART_RX_LOW_WATER) {
+        uart_rx_flow_set(0);
+      }
+    }
+  }
+}
+
+#else
+
+#define uart_rx_flow_check()
+
+#endif /* AVR_UART_RTSCTS || AVR_UART_XONXOFF */
+
+#ifdef AVR_UART_STATS
+
+/**
+ * @internal
+ * @brief Record the TX ring fill level after bytes are enqueued
+ */
+static inline void uart_tx_high_water(void) {
+  TX_COUNT_SIZE_TYPE count = uart_tx_count();
+  if (count > uart.stats.tx_high_water) {
+    uart.stats.tx_high_water = count;
+  }
+}
+
+#else
+
+#define uart_tx_high_water()
+
+#endif /* AVR_UART_STATS */
+
+/**
+ * @internal
+ * @brief External framing handlers
+ *
+ * Called from RX ISR when AVR_UART_FRAME is enabled to delimit frames as
+ * bytes are stored in, or dropped from, the RX ring.
+ *
+ * @param udr The received byte from UART data register
+ */
+extern void avr_uart_do_frame(uint8_t udr);
+extern void avr_uart_frame_dropped(uint8_t udr);
+extern void avr_uart_frame_flush(void);
+
+/**
+ * @internal
+ * @brief External line discipline handlers
+ *
+ * Called from RX ISR when AVR_UART_LINE is enabled. avr_uart_line_filter()
+ * sees every byte first and returns 0 for editing keys it consumed, the
+ * others delimit lines as bytes are stored in, or dropped from, the RX ring.
+ *
+ * @param udr The received byte from UART data register
+ */
+extern uint8_t avr_uart_line_filter(uint8_t udr);
+extern void avr_uart_do_line(uint8_t udr);
+extern void avr_uart_line_dropped(uint8_t udr);
+extern void avr_uart_line_flush(void);
+
+/**
+ * @internal
+ * @brief External record handlers
+ *
+ * Called from RX ISR when AVR_UART_RECORD is enabled to check records as
+ * bytes are stored in, or dropped from, the RX ring.
+ *
+ * @param udr The received byte from UART data register
+ */
+extern void avr_uart_do_record(uint8_t udr);
+extern void avr_uart_record_dropped(uint8_t udr);
+extern void avr_uart_record_flush(void);
+
+/**
+ * @internal
+ * @brief Account for a received byte that did not fit the RX ring
+ *
+ * @param udr The dropped byte
+ */
+static inline void uart_rx_dropped(uint8_t udr) {
+
+#if defined AVR_UART_FRAME
+  avr_uart_frame_dropped(udr);
+#elif defined AVR_UART_LINE
+  avr_uart_line_dropped(udr);
+#elif defined AVR_UART_RECORD
+  avr_uart_record_dropped(udr);
+#else
+  (void)udr;
+#endif
+
+#ifdef AVR_UART_STATS
+  uart.stats.rx_dropped++;
+#endif
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
+  uart.rx_error |= UART_RX_ERROR_OVERFLOW;
+#endif
+}
+
+#ifdef AVR_UART_LINE
+
+/**
+ * @internal
+ * @brief Take the newest byte back out of the RX ring
+ *
+ * @return 0 if the ring is empty
+ *
+ * @note Called from the RX ISR, which owns rx_in
+ */
+uint8_t avr_uart_line_unput(void) {
+
+  if (uart_rx_count() == 0) {
+    return 0;
+  }
+
+  uart.rx_in = uart.rx_in == 0 ? UART_RX_BUFFER_LEN - 1 : uart.rx_in - 1;
+
+#ifndef AVR_UART_SPSC
+  --uart.rx_count;
+#endif
+
+  return 1;
+}
+
+/**
+ * @internal
+ * @brief Queue echo bytes for the UDRE ISR
+ *
+ * Bytes that do not fit are not echoed, a slow link loses echo rather than
+ * holding up the RX ISR. The UDRE ISR sends echo before the next byte of the
+ * TX ring or block, so echo lands in the middle of output already queued.
+ *
+ * The echo stays out of the ring, but setting UDRIE here can still start
+ * the UDRE ISR in the middle of a main loop update of tx_count or UCSRnB.
+ * uart_tx_produce() and UART_ATOMIC_RMW() therefore run those updates with
+ * interrupts off.
+ *
+ * @note Called from the RX ISR
+ */
+void avr_uart_line_echo(const char *s, uint8_t len) {
+
+  uint8_t in = uart.echo_in;
+
+  while (len-- && ECHO_INDEX_NEXT(in) != uart.echo_out) {
+    uart.echo[in] = *s++;
+    in = ECHO_INDEX_NEXT(in);
+  }
+
+  uart.echo_in = in;
+  uart_rs485_tx_begin();
+  PORT_ENABLE_UDRE_INTERRUPT();
+}
+
+#endif /* AVR_UART_LINE */
+
+
+/**
+ * @internal
+ * @brief Notify the TX producer once enough space is free
+ *
+ * The handler only signals the main loop. Producing from it would race the
+ * main loop writing the ring with UDRE unmasked.
+ *
+ * @param count Fill level of the TX ring after the byte just sent
+ */
+static inline void uart_tx_wake(TX_COUNT_SIZE_TYPE count) {
+
+#ifdef AVR_UART_TX_WATERMARK
+  if (count == uart.tx_wake_count && uart.tx_wake_handler) {
+    (*uart.tx_wake_handler)(uart.tx_wake_data);
+  }
+#else
+  (void)count;
+#endif
+}
+
+/*****************************************************************************/
+/* Extern linkages */
+/*****************************************************************************/
+
+/**
+ * @internal
+ * @brief External pattern matching handler
+ *
+ * Called from RX ISR when AVR_UART_MATCH is enabled to check
+ * incoming bytes against registered patterns.
+ *
+ * @param udr The received byte from UART data register
+ */
+extern void avr_uart_do_match(uint8_t udr);
+
+#ifdef AVR_UART_NOBLOCK_MATCH
+
+_Static_assert(UART_MATCH_QUEUE_LEN > 0 && UART_MATCH_QUEUE_LEN < 255,
+    "UART_MATCH_QUEUE_LEN must be between 1 and 254");
+
+#define MATCH_QUEUE_NEXT(i) \
+  ((uint8_t)((i) + 1) == (UART_MATCH_QUEUE_LEN + 1) ? 0 : (uint8_t)((i) + 1))
+
+/**
+ * @internal
+ * @brief Queue a received byte for the matcher
+ *
+ * @param udr The received byte
+ *
+ * @note Called from the RXC ISR with interrupts disabled
+ */
+static inline void uart_match_byte(uint8_t udr) {
+
+  uint8_t in = uart.match_in;
+  uint8_t next = MATCH_QUEUE_NEXT(in);
+
+  /* The byte is still stored, patterns resynchronise on later bytes */
+  if (next == uart.match_out) {
+#ifdef AVR_UART_STATS
+    uart.stats.rx_match_dropped++;
+#endif
+    return;
+  }
+
+  uart.match_queue[in] = udr;
+  uart.match_in = next;
+}
+
+/**
+ * @internal
+ * @brief Match the queued bytes with interrupts enabled
+ *
+ * Only the outermost RXC ISR matches. An RXC ISR nesting into the scan
+ * stores and queues its byte and returns, the outer one picks the byte up
+ * before it clears match_busy. Interrupts are disabled again on return.
+ *
+ * @note Called from the RXC ISR with interrupts disabled
+ */
+static inline __attribute__((always_inline)) void uart_match_run(void) {
+
+  if (uart.match_busy) {
+    return;
+  }
+  uart.match_busy = 1;
+
+  for (;;) {
+    uint8_t out = uart.match_out;
+
+    if (out == uart.match_in) {
+      break;
+    }
+
+    uint8_t udr = uart.match_queue[out];
+    uart.match_out = MATCH_QUEUE_NEXT(out);
+
+    sei();
+    avr_uart_do_match(udr);
+    cli();
+  }
+
+  uart.match_busy = 0;
+}
+
+#else
+
+#define uart_match_byte(udr) avr_uart_do_match(udr)
+
+#endif /* AVR_UART_NOBLOCK_MATCH */
+
+/*****************************************************************************/
+/* Functions */
+/*****************************************************************************/
+
+#ifdef AVR_UART_STDIO
+
+#if UART_HAS_TX
+
+/**
+ * @internal
+ * @brief STDIO stream putchar implementation
+ *
+ * Callback function for STDIO stream to send characters via UART.
+ * Automatically converts newline to carriage return + newline.
+ *
+ * @param c     Character to send
+ * @param stream FILE stream (unused)
+ * @return 0 on success, EOF on error
+ */
+int avr_uart_stream_putchar(char c, FILE *stream) {
+  (void)stream;
+
+  /* Both bytes of the line ending are enqueued at once */
+  if (c == '\n') {
+    avr_uart_send(AVR_UTIL_CONSTANT_CRLF, 2);
+  } else {
+    avr_uart_send_byte(c);
+  }
+  return 0;
+}
+
+#else
+#define avr_uart_stream_putchar NULL
+#endif /* UART_HAS_TX */
+
+#if UART_HAS_RX
+
+/**
+ * @internal
+ * @brief STDIO stream getchar implementation
+ *
+ * Callback function for STDIO stream to receive characters from UART.
+ *
+ * @param stream FILE stream (unused)
+ * @return Received character or EOF if error
+ *
+ * @note Returns EOF for null character (0x00)
+ */
+int avr_uart_stream_getchar(FILE *stream) {
+  /* 
+   * A null character can be received but shall get interpreted as string
+   * terminator.
+   */
+  char c;
+  return (c = avr_uart_recv_byte()) == '\0' ? EOF : c;
+}
+
+#else
+#define avr_uart_stream_getchar NULL
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_RX && UART_HAS_TX
+#define UART_STREAM_FLAGS _FDEV_SETUP_RW
+#elif UART_HAS_RX
+#define UART_STREAM_FLAGS _FDEV_SETUP_READ
+#else
+#define UART_STREAM_FLAGS _FDEV_SETUP_WRITE
+#endif
+
+/**
+ * @internal
+ * @brief STDIO stream object
+ *
+ * Combined input/output stream configured for UART communication, write or
+ * read only in single direction builds.
+ */
+static
+FILE __uart_iostream = FDEV_SETUP_STREAM(avr_uart_stream_putchar,
+    avr_uart_stream_getchar, UART_STREAM_FLAGS);
+
+#endif /* AVR_UART_STDIO */
+
+/*
+ * Baud rate divisors. The divisor is rounded to the nearest integer for both
+ * normal (16 samples a bit) and double speed (8 samples a bit) mode and double
+ * speed is only used when it gets closer to the requested rate, it samples
+ * less and tolerates less skew. A constant baud rate is planned at compile
+ * time by the UART_PLAN_* macros, rates set at runtime are divided the same
+ * way by uart_set_baud().
+ */
+#if defined AVR_UART_RUNTIME_CONFIG || defined AVR_UART_AUTOBAUD
+#define UART_BAUD_REQUESTED uart.baud
+#else
+#define UART_BAUD_REQUESTED ((uint32_t)UART_BAUD_RATE)
+
+_Static_assert(UART_CHAR_SIZE >= 5 && UART_CHAR_SIZE <= 8,
+    "UART_CHAR_SIZE must be between 5 and 8");
+_Static_assert(UART_STOP_BITS == 1 || UART_STOP_BITS == 2,
+    "UART_STOP_BITS must be 1 or 2");
+#endif
+
+#ifndef AVR_UART_RUNTIME_CONFIG
+/* Auto-baud starts out at UART_BAUD_RATE, so it has to be reachable too */
+_Static_assert(UART_PLAN_ERROR(UART_BAUD_RATE) <= UART_BAUD_MAX_ERROR &&
+    UART_PLAN_ERROR(UART_BAUD_RATE) >= -UART_BAUD_MAX_ERROR,
+    "UART_BAUD_RATE is further than UART_BAUD_MAX_ERROR off at F_CPU");
+_Static_assert(UART_RX_MAX_LATENCY_US == 0 ||
+    UART_PLAN_RX_CHARS(UART_RX_MAX_LATENCY_US) <= UART_RX_CAPACITY,
+    "UART_RX_BUFFER_LEN cannot hold what arrives in UART_RX_MAX_LATENCY_US");
+#endif
+
+#ifdef AVR_UART_LINE
+_Static_assert(sizeof(uart.echo) + sizeof(uart.echo_in) +
+    sizeof(uart.echo_out) == UART_PLAN_SRAM_ECHO,
+    "UART_PLAN_SRAM_ECHO is out of date");
+#endif
+#ifdef AVR_UART_NOBLOCK_MATCH
+_Static_assert(sizeof(uart.match_queue) + sizeof(uart.match_in) +
+    sizeof(uart.match_out) + sizeof(uart.match_busy) ==
+    UART_PLAN_SRAM_MATCH_QUEUE, "UART_PLAN_SRAM_MATCH_QUEUE is out of date");
+#endif
+#ifdef AVR_UART_TX_DESC
+_Static_assert(sizeof(uart.tx_desc) + sizeof(uart.tx_desc_count) +
+    sizeof(uart.tx_desc_in) + sizeof(uart.tx_desc_out) ==
+    UART_PLAN_SRAM_TX_DESC, "UART_PLAN_SRAM_TX_DESC is out of date");
+#endif
+
+_Static_assert(UART_PLAN_SRAM <= UART_SRAM_MAX,
+    "UART buffers take more than UART_SRAM_MAX bytes of SRAM");
+_Static_assert(UART_PLAN_SRAM <= RAMEND - RAMSTART + 1,
+    "UART buffers take more than the SRAM of the device");
+
+static inline __attribute__((always_inline))
+uint16_t uart_baud_divisor(uint32_t baud, uint8_t samples) {
+
+  uint32_t d = UART_PLAN_DIVISOR_ROUNDED(baud, samples);
+
+  return d < 1 ? 1 : d > UART_PLAN_UBRR_MAX + 1 ? UART_PLAN_UBRR_MAX + 1 : d;
+}
+
+static inline __attribute__((always_inline))
+uint32_t uart_baud_diff(uint32_t baud, uint8_t samples, uint16_t d) {
+
+  uint32_t actual = F_CPU / ((uint32_t)samples * d);
+
+  return actual > baud ? actual - baud : baud - actual;
+}
+
+/**
+ * @internal
+ * @brief Program UBRR and U2X for the closest achievable baud rate
+ *
+ * @note Has to run after PORT_UART_INIT() which may reset UCSRA
+ */
+static inline __attribute__((always_inline))
+void uart_set_baud(uint32_t baud) {
+
+  uint16_t d16 = uart_baud_divisor(baud, 16);
+  uint16_t d8 = uart_baud_divisor(baud, 8);
+
+  if (uart_baud_diff(baud, 8, d8) < uart_baud_diff(baud, 16, d16)) {
+    PORT_UBRR = d8 - 1;
+    PORT_UCSRA |= _BV(PORT_U2X);
+  } else {
+    PORT_UBRR = d16 - 1;
+    PORT_UCSRA &= ~_BV(PORT_U2X);
+  }
+}
+
+uint32_t avr_uart_get_baud(void) {
+
+  uint8_t samples = PORT_UCSRA & _BV(PORT_U2X) ? 8 : 16;
+
+  return F_CPU / ((uint32_t)samples * (PORT_UBRR + 1));
+}
+
+int16_t avr_uart_get_baud_error(void) {
+
+  uint32_t baud = UART_BAUD_REQUESTED;
+
+  if (baud == 0) {
+    return 0;
+  }
+
+  return (int16_t)(((int32_t)avr_uart_get_baud() - (int32_t)baud) * 1000 /
+      (int32_t)baud);
+}
+
+#ifdef AVR_UART_RUNTIME_CONFIG
+
+void avr_uart_setup(struct avr_uart_config *config) {
+  if (!config) {
+    return;
+  }
+
+  if (config->baud_rate == 0) {
+    config->baud_rate = UART_BAUD_DEFAULT;
+  }
+
+  uart.baud = config->baud_rate;
+  PORT_UART_SET_CHAR_SIZE(config->char_size);
+  PORT_UART_SET_STOP_BITS(config->stop_bits);
+  PORT_UART_SET_PARITY(config->parity);
+
+#else /* !AVR_UART_RUNTIME_CONFIG */
+
+void avr_uart_setup() {
+
+#ifdef AVR_UART_AUTOBAUD
+  uart.baud = UART_BAUD_RATE;
+#endif
+  PORT_UART_SET_CHAR_SIZE(UART_CHAR_SIZE);
+  PORT_UART_SET_STOP_BITS(UART_STOP_BITS);
+  PORT_UART_SET_PARITY(UART_PARITY);
+
+#endif /* AVR_UART_RUNTIME_CONFIG */
+
+  PORT_UART_INIT();
+
+  /*
+   * The unused side is switched off again right away, no character can
+   * complete in between. Its pin is left to the port.
+   */
+#if !UART_HAS_RX
+  PORT_UCSRB &= ~(_BV(PORT_RXEN) | _BV(PORT_RXCIE));
+#elif !UART_HAS_TX
+  PORT_UCSRB &= ~_BV(PORT_TXEN);
+#endif
+
+#if defined AVR_UART_RUNTIME_CONFIG || defined AVR_UART_AUTOBAUD
+  uart_set_baud(UART_BAUD_REQUESTED);
+#else
+  PORT_UBRR = UART_PLAN_UBRR(UART_BAUD_RATE);
+  if (UART_PLAN_U2X(UART_BAUD_RATE)) {
+    PORT_UCSRA |= _BV(PORT_U2X);
+  } else {
+    PORT_UCSRA &= ~_BV(PORT_U2X);
+  }
+#endif
+
+#ifdef AVR_UART_RTSCTS
+  /* RTS is asserted low, CTS is pulled up to read as deasserted if open */
+  UART_RTS_PORT &= ~_BV(UART_RTS_BIT);
+  UART_RTS_DDR |= _BV(UART_RTS_BIT);
+  UART_CTS_DDR &= ~_BV(UART_CTS_BIT);
+  UART_CTS_PORT |= _BV(UART_CTS_BIT);
+  UART_CTS_PCMSK |= _BV(UART_CTS_PCINT_BIT);
+  PCICR |= _BV(UART_CTS_PCIE);
+#endif /* AVR_UART_RTSCTS */
+
+#ifdef AVR_UART_RS485
+  /* Receive until the first byte is enqueued */
+  UART_RS485_DE_PORT &= ~_BV(UART_RS485_DE_BIT);
+  UART_RS485_DE_DDR |= _BV(UART_RS485_DE_BIT);
+  PORT_UCSRB |= _BV(PORT_TXCIE);
+#endif /* AVR_UART_RS485 */
+
+#ifdef AVR_UART_PROFILE
+  /* Timer1 runs free at F_CPU, its overflows extend latency stamps */
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TIMSK1 |= _BV(TOIE1);
+#endif /* AVR_UART_PROFILE */
+
+#ifdef AVR_UART_PROFILE_PINS
+  UART_PROFILE_PORT &= ~(_BV(UART_PROFILE_RX_BIT) | _BV(UART_PROFILE_UDRE_BIT));
+  UART_PROFILE_DDR |= _BV(UART_PROFILE_RX_BIT) | _BV(UART_PROFILE_UDRE_BIT);
+#endif /* AVR_UART_PROFILE_PINS */
+
+#ifdef AVR_UART_STDIO
+  stdout = stdin = stderr = &__uart_iostream;
+#endif /* AVR_UART_STDIO */
+
+  avr_uart_flush();
+}
+
+#ifdef AVR_UART_AUTOBAUD
+
+/* Rates a measurement is snapped to when within UART_AUTOBAUD_SNAP */
+static const uint32_t uart_std_bauds[] PROGMEM = {
+  1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 76800, 115200,
+  230400, 250000, 500000, 1000000
+};
+
+/**
+ * @internal
+ * @brief Timer1 count extended by its overflow flag
+ *
+ * The flag is read after the count, an overflow in between is caught by
+ * reading the count again. Falling edges of the sync byte are at most two
+ * bit times apart, less than one overflow period down to 1200 baud. Timer1
+ * interrupts are masked while it is borrowed, so nothing else clears the
+ * flag.
+ */
+static inline uint32_t uart_autobaud_now(uint16_t *high) {
+
+  uint16_t low = TCNT1;
+
+  if (TIFR1 & _BV(TOV1)) {
+    TIFR1 = _BV(TOV1);
+    (*high)++;
+    low = TCNT1;
+  }
+
+  return (uint32_t)*high << 16 | low;
+}
+
+/**
+ * @internal
+ * @brief Wait with interrupts enabled until the RXD pin reads level
+ *
+ * Waits for the start bit against the deadline in Timer1 overflows. The edge
+ * is not timed, interrupts may delay seeing it.
+ *
+ * @return 0 on timeout, 1 otherwise
+ */
+static uint8_t uart_autobaud_start(uint8_t level, uint16_t *high,
+    uint32_t deadline) {
+
+  while (!(PORT_RXD_PIN & _BV(PORT_RXD_BIT)) != !level) {
+    if (deadline && uart_autobaud_now(high) >> 16 >= deadline) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @internal
+ * @brief Busy wait until the RXD pin reads level
+ *
+ * Every timed edge is awaited with this bare polling loop, so they all see
+ * the same sampling delay of a few cycles. The count bounds the wait to more
+ * than two bit times at the lowest rate.
+ *
+ * @return 0 on timeout, 1 otherwise
+ */
+static inline __attribute__((always_inline))
+uint8_t uart_autobaud_wait(uint8_t level) {
+
+  uint16_t n = UINT16_MAX;
+
+  while (!(PORT_RXD_PIN & _BV(PORT_RXD_BIT)) != !level) {
+    if (--n == 0) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+uint32_t avr_uart_autobaud(uint16_t timeout_ms) {
+
+  /* Timer1 overflows before giving up, 0 waits forever */
+  uint32_t deadline = ((uint32_t)timeout_ms * (F_CPU / 1000)) >> 16;
+  uint32_t t[4];
+  uint16_t high = 0;
+  uint8_t i = 0;
+
+  if (timeout_ms && deadline == 0) {
+    deadline = 1;
+  }
+
+#if UART_HAS_TX
+  avr_uart_flush_tx();
+#endif
+  UART_ATOMIC_RMW(PORT_UCSRB &= ~_BV(PORT_RXEN));
+
+  uint8_t timsk1 = TIMSK1;
+  uint8_t tccr1a = TCCR1A;
+  uint8_t tccr1b = TCCR1B;
+
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TIFR1 = _BV(TOV1);
+
+  /*
+   * 0x55 has a falling edge at its start bit and before each 0 bit. The
+   * start bit is awaited with interrupts enabled, the four edges after it
+   * are timed by the same loop with interrupts disabled.
+   */
+  if (uart_autobaud_start(1, &high, deadline) &&
+      uart_autobaud_start(0, &high, deadline)) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      for (; i < 4; i++) {
+        if (!uart_autobaud_wait(1) || !uart_autobaud_wait(0)) {
+          break;
+        }
+        t[i] = uart_autobaud_now(&high);
+      }
+    }
+  }
+
+  TCCR1B = tccr1b;
+  TCCR1A = tccr1a;
+  TIMSK1 = timsk1;
+
+  uint32_t baud = 0;
+
+  if (i == 4) {
+
+    /* Six bit times between the first and the last timed edge */
+    uint32_t span = t[3] - t[0];
+
+    for (i = 0; i < 3; i++) {
+      uint32_t d = (t[i + 1] - t[i]) * 3;
+
+      /* Every edge two bit times after the previous one, within 25 % */
+      if (d < span - span / 4 || d > span + span / 4) {
+        span = 0;
+        break;
+      }
+    }
+
+    if (span > 0) {
+      baud = (F_CPU * 6 + span / 2) / span;
+
+      for (i = 0; i < sizeof(uart_std_bauds) / sizeof(uart_std_bauds[0]);
+          i++) {
+        uint32_t std = pgm_read_dword(&uart_std_bauds[i]);
+        uint32_t diff = baud > std ? baud - std : std - baud;
+
+        if (diff <= std / 100 * UART_AUTOBAUD_SNAP) {
+          baud = std;
+          break;
+        }
+      }
+
+      uart.baud = baud;
+      uart_set_baud(baud);
+    }
+  }
+
+  avr_uart_flush_rx();
+  UART_ATOMIC_RMW(PORT_UCSRB |= _BV(PORT_RXEN));
+
+  return baud;
+}
+
+#endif /* AVR_UART_AUTOBAUD */
+
+#if UART_HAS_TX
+
+/**
+ * @internal
+ * @brief UART Data Register Empty ISR body
+ *
+ * Interrupt service routine triggered when the UART transmit data
+ * register is empty and ready for new data. Transfers bytes from
+ * the TX circular buffer to the UART hardware.
+ *
+ * @note Runs in ISR context with other interrupts blocked
+ */
+static inline __attribute__((always_inline)) void uart_udre_isr(void) {
+
+#ifdef AVR_UART_XONXOFF
+
+  /* Flow control bytes go first and are sent even while stopped */
+  if (uart.tx_ctrl) {
+    UART_UDR_WRITE(uart.tx_ctrl);
+    uart.tx_ctrl = 0;
+    if (uart.tx_stopped || uart_tx_idle()) {
+      PORT_DISABLE_UDRE_INTERRUPT();
+    }
+    return;
+  }
+
+  /* Restarted by the RX ISR once XON arrives */
+  if (uart.tx_stopped) {
+    PORT_DISABLE_UDRE_INTERRUPT();
+    return;
+  }
+
+#endif /* AVR_UART_XONXOFF */
+
+#ifdef AVR_UART_RTSCTS
+
+  /* Restarted by the CTS pin change ISR once CTS is asserted again */
+  if (UART_CTS_PIN & _BV(UART_CTS_BIT)) {
+    PORT_DISABLE_UDRE_INTERRUPT();
+    return;
+  }
+
+#endif /* AVR_UART_RTSCTS */
+
+#ifdef AVR_UART_LINE
+  if (uart_echo_send()) {
+    return;
+  }
+#endif
+
+#ifdef AVR_UART_TX_DESC
+  if (uart_tx_desc_send()) {
+    return;
+  }
+#endif
+
+#ifdef AVR_UART_SPSC
+
+  TX_INDEX_SIZE_TYPE tx_out = uart.tx_out;
+
+  if (tx_out != uart.tx_in) {
+    UART_UDR_WRITE(uart.tx_buffer[tx_out]);
+
+#ifdef AVR_UART_STATS
+    uart.stats.tx_bytes++;
+#endif
+
+    uart.tx_out = tx_out = TX_INDEX_NEXT(tx_out);
+    uart_profile_tx_sent(tx_out);
+
+    /* A block queued behind the last ring byte keeps UDRE running */
+    if (tx_out == uart.tx_in && !uart_tx_desc_pending()) {
+      PORT_DISABLE_UDRE_INTERRUPT();
+    }
+
+#ifdef AVR_UART_TX_WATERMARK
+    uart_tx_wake(uart_tx_count());
+#endif
+  } else {
+    PORT_DISABLE_UDRE_INTERRUPT();
+  }
+
+#else /* !AVR_UART_SPSC */
+
+  if (uart.tx_count > 0) {
+    UART_UDR_WRITE(uart.tx_buffer[uart.tx_out]);
+
+#ifdef AVR_UART_STATS
+    uart.stats.tx_bytes++;
+#endif
+
+    uart.tx_out = TX_INDEX_NEXT(uart.tx_out);
+    uart_profile_tx_sent(uart.tx_out);
+
+    if(--uart.tx_count == 0 && !uart_tx_desc_pending()) {
+      PORT_DISABLE_UDRE_INTERRUPT();
+    }
+
+    uart_tx_wake(uart.tx_count);
+  } else {
+    PORT_DISABLE_UDRE_INTERRUPT();
+  }
+
+#endif /* AVR_UART_SPSC */
+}
+
+ISR(PORT_UDRE_VECT, ISR_BLOCK) {
+
+  UART_PROFILE_BEGIN(UART_PROFILE_UDRE_BIT);
+  uart_udre_isr();
+  UART_PROFILE_END(UART_PROFILE_UDRE_BIT, udre_isr);
+}
+
+#endif /* UART_HAS_TX */
+
+#ifdef AVR_UART_PROFILE
+
+/**
+ * @internal
+ * @brief Timer1 overflow ISR
+ *
+ * Counts the high word of the TX latency timestamps.
+ *
+ * @note Runs in ISR context with other interrupts blocked
+ */
+ISR(TIMER1_OVF_vect, ISR_BLOCK) {
+  uart.profile.overflows++;
+}
+
+#endif /* AVR_UART_PROFILE */
+
+#ifdef AVR_UART_RTSCTS
+
+/**
+ * @internal
+ * @brief CTS pin change ISR
+ *
+ * Restarts transmission once the peer asserts CTS (low) and bytes are
+ * waiting. The UDRE ISR stops by itself while CTS is deasserted or the TX
+ * ring is empty.
+ *
+ * @note Runs in ISR context with other interrupts blocked
+ */
+ISR(UART_CTS_PCINT_VECT, ISR_BLOCK) {
+
+  if (!(UART_CTS_PIN & _BV(UART_CTS_BIT)) && !uart_tx_idle()) {
+    PORT_ENABLE_UDRE_INTERRUPT();
+  }
+}
+
+#endif /* AVR_UART_RTSCTS */
+
+#ifdef AVR_UART_RS485
+
+/**
+ * @internal
+ * @brief UART Transmit Complete ISR
+ *
+ * Triggered once the last stop bit has left the shift register and no new
+ * byte is waiting in UDR. Drops the RS-485 driver enable pin unless the UDRE
+ * ISR was held off while bytes are still waiting in the TX ring.
+ *
+ * While XOFF holds the bytes back the pin is dropped as well. With /RE tied
+ * to DE the transceiver could otherwise never receive the XON that resumes
+ * them, the RX ISR raises the pin again when it arrives.
+ *
+ * @note Runs in ISR context with other interrupts blocked
+ */
+ISR(PORT_TXC_VECT, ISR_BLOCK) {
+
+#ifdef AVR_UART_XONXOFF
+  uint8_t stopped = uart.tx_stopped && !uart.tx_ctrl;
+#else
+  uint8_t stopped = 0;
+#endif
+
+  if (stopped || uart_tx_idle()) {
+    UART_RS485_DE_PORT &= ~_BV(UART_RS485_DE_BIT);
+  }
+}
+
+#endif /* AVR_UART_RS485 */
+
+#if UART_HAS_RX
+
+/**
+ * @internal
+ * @brief UART Receive Complete ISR body
+ *
+ * Interrupt service routine triggered when a byte is received
+ * via UART. Stores the byte in the RX circular buffer and
+ * optionally checks for pattern matches.
+ *
+ * @note Runs in ISR context with other interrupts blocked
+ */
+static inline __attribute__((always_inline)) void uart_rxc_isr(void) {
+
+#if defined AVR_UART_STATS || \
+  (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
+
+  /* Error flags are only valid until UDR is read */
+  uint8_t status = PORT_UCSRA;
+
+#endif
+
+  uint8_t udr = PORT_UDR;
+
+#ifdef AVR_UART_STATS
+
+  uart.stats.rx_bytes++;
+  if (status & _BV(PORT_DOR)) {
+    uart.stats.rx_data_overrun++;
+  }
+  if (status & _BV(PORT_FE)) {
+    uart.stats.rx_frame_error++;
+  }
+  if (status & _BV(PORT_UPE)) {
+    uart.stats.rx_parity_error++;
+  }
+
+#endif /* AVR_UART_STATS */
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
+
+  uart.rx_error |=
+    (status & _BV(PORT_DOR) ? UART_RX_ERROR_DATA_OVERRUN : 0) |
+    (status & _BV(PORT_FE) ? UART_RX_ERROR_FRAME : 0) |
+    (status & _BV(PORT_UPE) ? UART_RX_ERROR_PARITY : 0);
+
+#endif
+
+#ifdef AVR_UART_XONXOFF
+
+  /* Flow control from the peer is consumed here and never buffered */
+  if (udr == UART_XOFF) {
+    uart.tx_stopped = 1;
+    return;
+  }
+  if (udr == UART_XON) {
+    uart.tx_stopped = 0;
+    /* An empty ring would keep UDRE firing with nothing to send */
+    if (!uart_tx_idle()) {
+      uart_rs485_tx_begin();
+      PORT_ENABLE_UDRE_INTERRUPT();
+    }
+    return;
+  }
+
+#endif /* AVR_UART_XONXOFF */
+
+#ifdef AVR_UART_MATCH
+
+  uart_match_byte(udr);
+
+#endif /* AVR_UART_MATCH */
+
+#ifdef AVR_UART_LINE
+
+  /* Editing keys and the LF of CR LF are consumed here */
+  if (!avr_uart_line_filter(udr)) {
+    return;
+  }
+
+#endif /* AVR_UART_LINE */
+
+#ifdef AVR_UART_SPSC
+
+  RX_INDEX_SIZE_TYPE rx_in = uart.rx_in;
+  RX_INDEX_SIZE_TYPE rx_next = RX_INDEX_NEXT(rx_in);
+
+  /* A full ring drops the byte, rx_out belongs to the main loop */
+  if (rx_next == uart.rx_out) {
+    uart_rx_dropped(udr);
+    return;
+  }
+
+  uart.rx_buffer[rx_in] = udr;
+  uart.rx_in = rx_next;
+
+#else /* !AVR_UART_SPSC */
+
+  if (uart.rx_count == UART_RX_BUFFER_LEN) {
+
+    uart_rx_dropped(udr);
+
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_DROP_OLDEST)
+
+    uart.rx_out = RX_INDEX_NEXT(uart.rx_out);
+    --uart.rx_count;
+
+#else
+
+    return;
+
+#endif
+  }
+
+  uart.rx_buffer[uart.rx_in] = udr;
+  ++uart.rx_count;
+
+  uart.rx_in = RX_INDEX_NEXT(uart.rx_in);
+
+#endif /* AVR_UART_SPSC */
+
+#ifdef AVR_UART_FRAME
+
+  avr_uart_do_frame(udr);
+
+#endif /* AVR_UART_FRAME */
+
+#ifdef AVR_UART_LINE
+
+  avr_uart_do_line(udr);
+
+#endif /* AVR_UART_LINE */
+
+#ifdef AVR_UART_RECORD
+
+  avr_uart_do_record(udr);
+
+#endif /* AVR_UART_RECORD */
+
+  uart_rx_flow_check();
+
+#ifdef AVR_UART_STATS
+
+  RX_COUNT_SIZE_TYPE count = uart_rx_count();
+  if (count > uart.stats.rx_high_water) {
+    uart.stats.rx_high_water = count;
+  }
+
+#endif /* AVR_UART_STATS */
+}
+
+/*
+ * With AVR_UART_NOBLOCK_MATCH the part run with interrupts blocked ends once
+ * the byte is stored, other interrupts and the next RXC are taken while the
+ * patterns are matched. Profiling covers the blocking part only.
+ */
+ISR(PORT_RXC_VECT, ISR_BLOCK) {
+
+  UART_PROFILE_BEGIN(UART_PROFILE_RX_BIT);
+  uart_rxc_isr();
+  UART_PROFILE_END(UART_PROFILE_RX_BIT, rx_isr);
+
+#ifdef AVR_UART_NOBLOCK_MATCH
+  uart_match_run();
+#endif
+}
+
+void avr_uart_flush_rx() {
+
+#ifdef AVR_UART_SPSC
+
+  uart.rx_out = uart.rx_in;
+
+#else /* !AVR_UART_SPSC */
+
+  uart.rx_in = uart.rx_out = 0;
+  uart.rx_count = 0;
+
+#endif /* AVR_UART_SPSC */
+
+#ifdef AVR_UART_FRAME
+
+  avr_uart_frame_flush();
+
+#endif /* AVR_UART_FRAME */
+
+#ifdef AVR_UART_LINE
+
+  avr_uart_line_flush();
+
+#endif /* AVR_UART_LINE */
+
+#ifdef AVR_UART_RECORD
+
+  avr_uart_record_flush();
+
+#endif /* AVR_UART_RECORD */
+
+  uart_rx_flow_resume();
+}
+
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_TX
+
+void avr_uart_flush_tx() {
+
+  UART_WAIT_WHILE(!uart_tx_idle());
+
+#ifdef AVR_UART_RS485
+  /* The last byte is still being shifted out until the TXC ISR */
+  UART_WAIT_WHILE(uart_rs485_busy());
+#endif
+
+#ifndef AVR_UART_SPSC
+
+  uart.tx_in = uart.tx_out = 0;
+  uart.tx_count = 0;
+
+#endif /* !AVR_UART_SPSC */
+}
+
+#endif /* UART_HAS_TX */
+
+#if UART_HAS_RX
+
+char avr_uart_peek_byte(void) {
+
+  UART_RX_READ_BEGIN();
+
+  char c = (uart_rx_count() > 0 ? uart.rx_buffer[uart.rx_out]: 0);
+
+  UART_RX_READ_END();
+
+  return c;
+}
+
+char avr_uart_recv_byte() {
+
+  /* Wait till atleast one character has been received */
+  UART_WAIT_WHILE(uart_rx_count() == 0);
+
+  UART_RX_READ_BEGIN();
+
+  RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+  char c = uart.rx_buffer[rx_out];
+  uart_rx_consume(RX_INDEX_NEXT(rx_out), 1);
+
+  UART_RX_READ_END();
+
+  return c;
+}
+
+char avr_uart_try_recv_byte() {
+
+  UART_RX_READ_BEGIN();
+
+  char c = (uart_rx_count() > 0 ?
+      ({
+        RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+        char c = uart.rx_buffer[rx_out];
+        uart_rx_consume(RX_INDEX_NEXT(rx_out), 1);
+
+        c;
+      }) :
+    0);
+
+  UART_RX_READ_END();
+
+  return c;
+}
+
+uint8_t avr_uart_try_recv(char *c) {
+
+  UART_RX_READ_BEGIN();
+
+  uint8_t ret = (uart_rx_count() > 0 &&
+      ({
+        RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+        *c = uart.rx_buffer[rx_out];
+        uart_rx_consume(RX_INDEX_NEXT(rx_out), 1);
+
+        1;
+      })
+    );
+
+  UART_RX_READ_END();
+
+  return ret;
+}
+
+size_t avr_uart_peek(char *str, size_t len) {
+
+  if (len > UART_RX_CAPACITY) {
+    len = UART_RX_CAPACITY;
+  }
+
+  /* Wait till atleast len characters has been received */
+  UART_WAIT_WHILE(uart_rx_count() < len);
+
+  UART_RX_READ_BEGIN();
+
+  RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+  size_t n = 0;
+
+  while (len--) {
+    *str++ = uart.rx_buffer[rx_out];
+    rx_out = RX_INDEX_NEXT(rx_out);
+    n++;
+  }
+
+  UART_RX_READ_END();
+
+  return n;
+}
+
+/*
+ * Bytes are copied out of the ring in at most two contiguous spans, one up to
+ * the end of rx_buffer and one from its start. The ISR only ever writes into
+ * the free part of the ring so the copy itself needs no masking, only the
+ * update of rx_out and rx_count does.
+ *
+ * When `len` is greater than `rx_count`, the loop shall wait for more
+ * characters until len reaches 0.
+ */
+size_t avr_uart_recv(char* str, size_t len) {
+
+  size_t n = 0;
+
+  while (len > 0) {
+
+    RX_COUNT_SIZE_TYPE count;
+
+    /* Wait till atleast one character has been received */
+    UART_WAIT_WHILE(uart_rx_count() == 0);
+
+    UART_RX_READ_BEGIN();
+
+    count = uart_rx_count();
+    if (count > len) {
+      count = len;
+    }
+
+    RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+    RX_COUNT_SIZE_TYPE span = UART_RX_BUFFER_LEN - rx_out;
+    if (span > count) {
+      span = count;
+    }
+
+    memcpy(str, &uart.rx_buffer[rx_out], span);
+    if (count > span) {
+      memcpy(str + span, &uart.rx_buffer[0], count - span);
+    }
+
+    if (count > span) {
+      rx_out = count - span;
+    } else {
+      rx_out = RX_INDEX_WRAP(rx_out + span);
+    }
+
+    uart_rx_consume(rx_out, count);
+
+    UART_RX_READ_END();
+
+    str += count;
+    len -= count;
+    n += count;
+  }
+
+  return n;
+}
+
+#ifdef AVR_UART_TIMEOUT
+
+size_t avr_uart_peek_timeout(char *str, size_t len, uint16_t ticks) {
+
+  struct _uart_timer t;
+
+  if (len > UART_RX_CAPACITY) {
+    len = UART_RX_CAPACITY;
+  }
+
+  uart_timer_start(&t, ticks);
+  UART_WAIT_WHILE_TIMED(uart_rx_count() < len, &t);
+
+  RX_COUNT_SIZE_TYPE count = uart_rx_count();
+  if (len > count) {
+    len = count;
+  }
+
+  return avr_uart_peek(str, len);
+}
+
+size_t avr_uart_recv_timeout(char *str, size_t len, uint16_t ticks) {
+
+  struct _uart_timer t;
+  size_t n = 0;
+
+  uart_timer_start(&t, ticks);
+
+  while (n < len) {
+    UART_WAIT_WHILE_TIMED(uart_rx_count() == 0, &t);
+
+    /* Only what has arrived is read, so avr_uart_recv() never blocks */
+    size_t count = uart_rx_count();
+    if (count == 0) {
+      break;
+    }
+    if (count > len - n) {
+      count = len - n;
+    }
+
+    n += avr_uart_recv(str + n, count);
+  }
+
+  return n;
+}
+
+#endif /* AVR_UART_TIMEOUT */
+
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_TX
+
+void avr_uart_send_byte(char c) {
+
+  UART_WAIT_WHILE(uart_tx_count() == UART_TX_CAPACITY);
+
+  TX_INDEX_SIZE_TYPE tx_in = uart.tx_in;
+  uart.tx_buffer[tx_in] = c;
+  uart_tx_produce(TX_INDEX_NEXT(tx_in), 1);
+  uart_tx_high_water();
+}
+
+char avr_uart_try_send_byte(char c) {
+
+  return ( (uart_tx_count() < UART_TX_CAPACITY) &&
+      ({
+        TX_INDEX_SIZE_TYPE tx_in = uart.tx_in;
+        uart.tx_buffer[tx_in] = c;
+        uart_tx_produce(TX_INDEX_NEXT(tx_in), 1);
+        uart_tx_high_water();
+        1;
+      })
+    );
+}
+
+/*
+ * Bytes are copied into the free part of the ring in at most two contiguous
+ * spans. The UDRE ISR only reads the filled part of the ring, so the interrupt
+ * is masked just for the update of tx_in and tx_count.
+ */
+void avr_uart_send(const char *s, size_t len) {
+
+  while (len > 0) {
+
+    /* Wait till there is room for atleast one character */
+    UART_WAIT_WHILE(uart_tx_count() == UART_TX_CAPACITY);
+
+    TX_COUNT_SIZE_TYPE count = UART_TX_CAPACITY - uart_tx_count();
+
+    if (count > len) {
+      count = len;
+    }
+
+    TX_INDEX_SIZE_TYPE tx_in = uart.tx_in;
+    TX_COUNT_SIZE_TYPE span = UART_TX_BUFFER_LEN - tx_in;
+    if (span > count) {
+      span = count;
+    }
+
+    memcpy(&uart.tx_buffer[tx_in], s, span);
+    if (count > span) {
+      memcpy(&uart.tx_buffer[0], s + span, count - span);
+    }
+
+    if (count > span) {
+      tx_in = count - span;
+    } else {
+      tx_in = TX_INDEX_WRAP(tx_in + span);
+    }
+
+    uart_tx_produce(tx_in, count);
+    uart_tx_high_water();
+
+    s += count;
+    len -= count;
+  }
+}
+
+#endif /* UART_HAS_TX */
+
+#if UART_HAS_RX
+
+void avr_uart_rx_acquire(const char **ptr, size_t *len) {
+
+  UART_RX_READ_BEGIN();
+
+  RX_COUNT_SIZE_TYPE count = uart_rx_count();
+  RX_INDEX_SIZE_TYPE rx_out = uart.rx_out;
+  RX_COUNT_SIZE_TYPE span = UART_RX_BUFFER_LEN - rx_out;
+  if (span > count) {
+    span = count;
+  }
+
+  UART_RX_READ_END();
+
+  if (ptr) {
+    *ptr = &uart.rx_buffer[rx_out];
+  }
+  if (len) {
+    *len = span;
+  }
+}
+
+void avr_uart_rx_release(size_t n) {
+
+  UART_RX_READ_BEGIN();
+
+  RX_COUNT_SIZE_TYPE count = uart_rx_count();
+  if (n > count) {
+    n = count;
+  }
+
+  uart_rx_consume(RX_INDEX_WRAP(uart.rx_out + n), n);
+
+  UART_RX_READ_END();
+}
+
+#endif /* UART_HAS_RX */
+
+#if UART_HAS_TX
+
+void avr_uart_tx_reserve(char **ptr, size_t *len) {
+
+  TX_COUNT_SIZE_TYPE count = UART_TX_CAPACITY - uart_tx_count();
+  TX_INDEX_SIZE_TYPE tx_in = uart.tx_in;
+  TX_COUNT_SIZE_TYPE span = UART_TX_BUFFER_LEN - tx_in;
+  if (span > count) {
+    span = count;
+  }
+
+  if (ptr) {
+    *ptr = &uart.tx_buffer[tx_in];
+  }
+  if (len) {
+    *len = span;
+  }
+}
+
+void avr_uart_tx_commit(size_t n) {
+
+  TX_COUNT_SIZE_TYPE count = UART_TX_CAPACITY - uart_tx_count();
+  TX_INDEX_SIZE_TYPE tx_in = uart.tx_in;
+  TX_COUNT_SIZE_TYPE span = UART_TX_BUFFER_LEN - tx_in;
+  if (span > count) {
+    span = count;
+  }
+  if (n > span) {
+    n = span;
+  }
+
+  if (n > 0) {
+    uart_tx_produce(TX_INDEX_WRAP(tx_in + n), n);
+    uart_tx_high_water();
+  }
+}
+
+#endif /* UART_HAS_TX */
 
-#undef TX_COUNT_SIZE_TYPE
-#if (UART_TX_BUFFER_LEN < 256)
-#define TX_COUNT_SIZE_TYPE uint8_t
-#elif (UART_TX_BUFFER_LEN < 65536)
-#define TX_COUNT_SIZE_TYPE uint16_t
-#elif (UART_TX_BUFFER_LEN < 4294967296)
-#define TX_COUNT_SIZE_TYPE uint16_t
-#else
-#error UART_TX_BUFFER_LEN too large
-#endif
+#ifdef AVR_UART_TX_DESC
 
- volatile RX_COUNT_SIZE_TYPE rx_count;
- volatile TX_COUNT_SIZE_TYPE tx_count;
+static uint8_t uart_tx_desc_queue(const char *data, size_t len, uint8_t pgm,
+    avr_uart_tx_handler done, void *done_data) {
 
- unsigned char rx_in;
- unsigned char rx_out;
+  if (len == 0) {
+    if (done) {
+      (*done)(done_data);
+    }
+    return 1;
+  }
 
- unsigned char tx_in;
- unsigned char tx_out;
+  /*
+   * A done handler may queue from the UDRE ISR, so the slot is claimed,
+   * filled and counted in one go. The ISR only looks at counted blocks.
+   */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
 
- char rx_buffer[UART_RX_BUFFER_LEN];
- char tx_buffer[UART_TX_BUFFER_LEN];
+    if (uart.tx_desc_count == UART_TX_DESC_QUEUE_LEN) {
+      return 0;
+    }
 
-} uart;
+#ifndef AVR_UART_SPSC
+    /* A full ring has tx_in == tx_out, the marker would skip the ring bytes */
+    if (uart_tx_count() == UART_TX_CAPACITY) {
+      return 0;
+    }
+#endif
 
+    struct _uart_tx_desc *desc = &uart.tx_desc[uart.tx_desc_in];
 
-/*****************************************************************************/
-/* Extern linkages */
-/*****************************************************************************/
+    desc->data = data;
+    desc->len = len;
+    desc->marker = uart.tx_in;
+    desc->pgm = pgm;
+    desc->done = done;
+    desc->done_data = done_data;
 
-/**
- * @internal
- * @brief External pattern matching handler
- *
- * Called from RX ISR when AVR_UART_MATCH is enabled to check
- * incoming bytes against registered patterns.
- *
- * @param udr The received byte from UART data register
- */
-extern void avr_uart_do_match(uint8_t udr);
+    uart.tx_desc_in = uart.tx_desc_in + 1 == UART_TX_DESC_QUEUE_LEN ?
+      0 : uart.tx_desc_in + 1;
+    uart.tx_desc_count++;
+  }
 
-/*****************************************************************************/
-/* Functions */
-/*****************************************************************************/
+  uart_rs485_tx_begin();
+  UART_UDRE_UNMASK();
 
-#ifdef AVR_UART_STDIO
+  return 1;
+}
 
-/**
- * @internal
- * @brief STDIO stream putchar implementation
- *
- * Callback function for STDIO stream to send characters via UART.
- * Automatically converts newline to carriage return + newline.
- *
- * @param c     Character to send
- * @param stream FILE stream (unused)
- * @return 0 on success, EOF on error
- */
-int avr_uart_stream_putchar(char c, FILE *stream) {
-  if (c == '\n') {
-    avr_uart_stream_putchar('\r', stream);
-  }
-  avr_uart_send_byte(c);
-  return 0;
+uint8_t avr_uart_send_desc(const void *data, size_t len,
+    avr_uart_tx_handler done, void *done_data) {
+
+  return uart_tx_desc_queue(data, len, 0, done, done_data);
 }
 
-/**
- * @internal
- * @brief STDIO stream getchar implementation
- *
- * Callback function for STDIO stream to receive characters from UART.
- *
- * @param stream FILE stream (unused)
- * @return Received character or EOF if error
- *
- * @note Returns EOF for null character (0x00)
- */
-int avr_uart_stream_getchar(FILE *stream) {
-  /* 
-   * A null character can be received but shall get interpreted as string
-   * terminator.
-   */
-  char c;
-  return (c = avr_uart_recv_byte()) == '\0' ? EOF : c;
+uint8_t avr_uart_pgm_send_desc(PGM_P data, size_t len,
+    avr_uart_tx_handler done, void *done_data) {
+
+  return uart_tx_desc_queue(data, len, 1, done, done_data);
 }
 
-/**
- * @internal
- * @brief STDIO stream object
- *
- * Combined input/output stream configured for UART communication.
- */
-static
-FILE __uart_iostream = FDEV_SETUP_STREAM(avr_uart_stream_putchar,
-    avr_uart_stream_getchar, _FDEV_SETUP_RW);
+#endif /* AVR_UART_TX_DESC */
 
-#endif /* AVR_UART_STDIO */
+#ifdef AVR_UART_TX_WATERMARK
 
-#ifdef AVR_UART_RUNTIME_CONFIG
+void avr_uart_set_tx_watermark(size_t free, avr_uart_tx_handler handler,
+    void *data) {
 
-void avr_uart_setup(struct avr_uart_config *config) {
-  if (!config) {
-    return;
+  if (free == 0 || free > UART_TX_CAPACITY) {
+    handler = NULL;
   }
 
-  if (config->baud_rate == 0) {
-    config->baud_rate = UART_BAUD_DEFAULT;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uart.tx_wake_count = UART_TX_CAPACITY - free;
+    uart.tx_wake_handler = handler;
+    uart.tx_wake_data = data;
   }
+}
 
-  PORT_UART_SET_BAUD_RATE(config->baud_rate);
-  PORT_UART_SET_CHAR_SIZE(config->char_size);
-  PORT_UART_SET_STOP_BITS(config->stop_bits);
-  PORT_UART_SET_PARITY(config->parity);
-
-#else /* !AVR_UART_RUNTIME_CONFIG */
-
-void avr_uart_setup() {
+#endif /* AVR_UART_TX_WATERMARK */
 
-  PORT_UART_SET_BAUD_RATE(UART_BAUD_RATE);
-  PORT_UART_SET_CHAR_SIZE(UART_CHAR_SIZE);
-  PORT_UART_SET_STOP_BITS(UART_STOP_BITS);
-  PORT_UART_SET_PARITY(UART_PARITY);
+#if (UART_RX_OVERFLOW_POLICY == UART_RX_OVERFLOW_FLAG_ERROR)
 
-#endif /* AVR_UART_RUNTIME_CONFIG */
+uint8_t avr_uart_rx_error(void) {
 
-  PORT_UART_INIT();
+  uint8_t error;
 
-#ifdef AVR_UART_STDIO
-  stdout = stdin = stderr = &__uart_iostream;
-#endif /* AVR_UART_STDIO */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    error = uart.rx_error;
+    uart.rx_error = 0;
+  }
 
-  avr_uart_flush();
+  return error;
 }
 
-/**
- * @internal
- * @brief UART Data Register Empty ISR
- *
- * Interrupt service routine triggered when the UART transmit data
- * register is empty and ready for new data. Transfers bytes from
- * the TX circular buffer to the UART hardware.
- *
- * @note Runs in ISR context with other interrupts blocked
- */
-ISR(PORT_UDRE_VECT, ISR_BLOCK) {
+#endif
 
-  if (uart.tx_count > 0) {
-    PORT_UDR = uart.tx_buffer[uart.tx_out];
+#ifdef AVR_UART_STATS
 
-    if (++uart.tx_out == UART_TX_BUFFER_LEN) {
-      uart.tx_out = 0;
-    }
+void avr_uart_get_stats(struct avr_uart_stats *stats) {
 
-    if(--uart.tx_count == 0) {
-      PORT_DISABLE_UDRE_INTERRUPT();
-    }
+  if (!stats) {
+    return;
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *stats = uart.stats;
   }
 }
 
-/**
- * @internal
- * @brief UART Receive Complete ISR
- *
- * Interrupt service routine triggered when a byte is received
- * via UART. Stores the byte in the RX circular buffer and
- * optionally checks for pattern matches.
- *
- * @note Runs in ISR context with other interrupts blocked
- */
-ISR(PORT_RXC_VECT, ISR_BLOCK) {
+void avr_uart_reset_stats(void) {
 
-#ifdef AVR_UART_MATCH
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&uart.stats, 0, sizeof(uart.stats));
+  }
+}
 
-  uint8_t udr = PORT_UDR;
-  avr_uart_do_match(udr);
+#endif /* AVR_UART_STATS */
 
-#else /* !AVR_UART_MATCH */
+#ifdef AVR_UART_PROFILE
 
-#define udr PORT_UDR
+static void uart_timing_get(struct avr_uart_timing *out,
+    const struct _uart_timing *t) {
 
-#endif /* AVR_UART_MATCH */
+  out->min = t->min;
+  out->max = t->max;
+  out->avg = t->count ? t->sum / t->count : 0;
+  out->count = t->count;
+}
 
-  uart.rx_buffer[uart.rx_in] = udr;
-  ++uart.rx_count;
+void avr_uart_get_profile(struct avr_uart_profile *profile) {
 
-  if (++uart.rx_in == UART_RX_BUFFER_LEN) {
-    uart.rx_in = 0;
+  if (!profile) {
+    return;
   }
-}
 
-void avr_uart_flush_rx() {
+  struct _uart_timing rx_isr, udre_isr, tx_latency;
 
-  uart.rx_in = uart.rx_out = 0;
-  uart.rx_count = 0;
-}
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rx_isr = uart.profile.rx_isr;
+    udre_isr = uart.profile.udre_isr;
+    tx_latency = uart.profile.tx_latency;
+  }
 
-void avr_uart_flush_tx() {
+  /* Divided outside the atomic block */
+  uart_timing_get(&profile->rx_isr, &rx_isr);
+  uart_timing_get(&profile->udre_isr, &udre_isr);
+  uart_timing_get(&profile->tx_latency, &tx_latency);
+}
 
-  while(uart.tx_count > 0);
+void avr_uart_reset_profile(void) {
 
-  uart.tx_in = uart.tx_out = 0;
-  uart.tx_count = 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&uart.profile.rx_isr, 0, sizeof(uart.profile.rx_isr));
+    memset(&uart.profile.udre_isr, 0, sizeof(uart.profile.udre_isr));
+    memset(&uart.profile.tx_latency, 0, sizeof(uart.profile.tx_latency));
+    uart.profile.tx_pending = 0;
+  }
 }
 
-char avr_uart_peek_byte(void) {
+#endif /* AVR_UART_PROFILE */
 
-  return (uart.rx_count > 0 ? uart.rx_buffer[uart.rx_out]: 0);
-}
+#if UART_HAS_TX
 
-char avr_uart_recv_byte() {
+void avr_uart_pgm_send(PGM_P s) {
 
-  /* Wait till atleast one character has been received */
-  while ( !(uart.rx_count > 0) );
+  for (char c = pgm_read_byte(s); c != 0; c = pgm_read_byte(++s)) {
+    avr_uart_send_byte(c);
+  } 
+}
 
-  PORT_DISABLE_RXC_INTERRUPT();
+/*
+ * Number formatting avoids the software division of AVR. Decimal digits are
+ * found by repeatedly subtracting powers of ten, at most nine subtractions a
+ * digit, hexadecimal digits by shifting. Each number is formatted into a
+ * local buffer and enqueued with one avr_uart_send(). The avr_uart_fmt_*
+ * formatters are shared with avr_uart_printf.c.
+ */
 
-  uart.rx_count--;
-  char c = uart.rx_buffer[uart.rx_out];
-  if (++uart.rx_out == UART_RX_BUFFER_LEN) {
-    uart.rx_out = 0;
-  }
+static const uint16_t uart_pow10_16[] PROGMEM = {
+  10000, 1000, 100, 10
+};
 
-  PORT_ENABLE_RXC_INTERRUPT();
+static const uint32_t uart_pow10_32[] PROGMEM = {
+  1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10
+};
 
-  return c;
-}
+/**
+ * @internal
+ * @brief Format a 16-bit value as decimal, return the number of characters
+ */
+uint8_t avr_uart_fmt_u16(char *buf, uint16_t u) {
 
-char avr_uart_try_recv_byte() {
+  uint8_t n = 0;
 
-  return (uart.rx_count > 0 ?
-      ({
-        PORT_DISABLE_RXC_INTERRUPT();
+  for (uint8_t i = 0; i < sizeof(uart_pow10_16) / sizeof(uart_pow10_16[0]);
+      i++) {
+    uint16_t p = pgm_read_word(&uart_pow10_16[i]);
+    char d = '0';
 
-        uart.rx_count--;
-        char c = uart.rx_buffer[uart.rx_out];
-        if (++uart.rx_out == UART_RX_BUFFER_LEN) {
-          uart.rx_out = 0;
-        }
+    while (u >= p) {
+      u -= p;
+      d++;
+    }
+    if (n > 0 || d != '0') {
+      buf[n++] = d;
+    }
+  }
 
-        PORT_ENABLE_RXC_INTERRUPT();
+  buf[n++] = '0' + (uint8_t)u;
 
-        c;
-      }) :
-    0);
+  return n;
 }
 
-size_t avr_uart_peek(char *str, size_t len) {
+/**
+ * @internal
+ * @brief Format a 32-bit value as decimal, return the number of characters
+ */
+uint8_t avr_uart_fmt_u32(char *buf, uint32_t u) {
 
-  if (len > UART_RX_BUFFER_LEN) {
-    len = UART_RX_BUFFER_LEN;
+  /* 16-bit subtractions are cheaper, use them once the value fits */
+  if (u <= 0xffff) {
+    return avr_uart_fmt_u16(buf, u);
   }
 
-  /* Wait till atleast len characters has been received */
-  while (uart.rx_count < len);
+  uint8_t n = 0;
 
-  unsigned char rx_out = uart.rx_out;
-  size_t n = 0;
+  for (uint8_t i = 0; i < sizeof(uart_pow10_32) / sizeof(uart_pow10_32[0]);
+      i++) {
+    uint32_t p = pgm_read_dword(&uart_pow10_32[i]);
+    char d = '0';
 
-  while (len--) {
-    *str++ = uart.rx_buffer[rx_out++];
-    if (rx_out == UART_RX_BUFFER_LEN) {
-      rx_out = 0;
+    while (u >= p) {
+      u -= p;
+      d++;
+    }
+    if (n > 0 || d != '0') {
+      buf[n++] = d;
     }
-    n++;
   }
 
+  buf[n++] = '0' + (uint8_t)u;
+
   return n;
 }
 
-/*
- * When `len` is greater than `rx_count`,
- * avr_uart_recv_byte will block and the loop shall run until len reaches 0.
+/**
+ * @internal
+ * @brief Format the low `digits` nibbles of u as upper case hexadecimal
  */
-size_t avr_uart_recv(char* str, size_t len) {
+uint8_t avr_uart_fmt_hex(char *buf, uint32_t u, uint8_t digits) {
 
-  size_t n = 0;
-
-  while(len--) {
-    *str++ = avr_uart_recv_byte();
-    n++;
+  for (uint8_t i = digits; i > 0; i--) {
+    uint8_t d = u & 0x0f;
+    buf[i - 1] = d < 10 ? '0' + d : 'A' - 10 + d;
+    u >>= 4;
   }
 
-  return n;
+  return digits;
 }
 
-void avr_uart_send_byte(char c) {
+void avr_uart_send_uint8(uint8_t u) {
+
+  char buf[3];
+  avr_uart_send(buf, avr_uart_fmt_u16(buf, u));
+}
+
+void avr_uart_send_uint16(uint16_t u) {
+
+  char buf[5];
+  avr_uart_send(buf, avr_uart_fmt_u16(buf, u));
+}
+
+void avr_uart_send_uint32(uint32_t u) {
+
+  char buf[10];
+  avr_uart_send(buf, avr_uart_fmt_u32(buf, u));
+}
+
+void avr_uart_send_int8(int8_t n) {
+
+  avr_uart_send_int16(n);
+}
 
-  while (uart.tx_count == UART_TX_BUFFER_LEN);
+void avr_uart_send_int16(int16_t n) {
 
-  PORT_DISABLE_UDRE_INTERRUPT();
+  char buf[6];
+  uint8_t len = 0;
 
-  ++uart.tx_count;
-  uart.tx_buffer[uart.tx_in] = c;
-  if (++uart.tx_in == UART_TX_BUFFER_LEN) {
-    uart.tx_in = 0;
+  if (n < 0) {
+    buf[len++] = '-';
   }
 
-  PORT_ENABLE_UDRE_INTERRUPT();
+  /* Negated as unsigned so that INT16_MIN does not overflow */
+  len += avr_uart_fmt_u16(buf + len, n < 0 ? -(uint16_t)n : (uint16_t)n);
+  avr_uart_send(buf, len);
 }
 
-char avr_uart_try_send_byte(char c) {
+void avr_uart_send_int32(int32_t n) {
 
-  return ( (uart.tx_count < UART_TX_BUFFER_LEN) &&
-      ({
-        PORT_DISABLE_UDRE_INTERRUPT();
+  char buf[11];
+  uint8_t len = 0;
 
-        ++uart.tx_count;
-        uart.tx_buffer[uart.tx_in] = c;
-        if (++uart.tx_in == UART_TX_BUFFER_LEN) {
-          uart.tx_in = 0;
-        }
+  if (n < 0) {
+    buf[len++] = '-';
+  }
 
-        PORT_ENABLE_UDRE_INTERRUPT();
-      })
-    );
+  len += avr_uart_fmt_u32(buf + len, n < 0 ? -(uint32_t)n : (uint32_t)n);
+  avr_uart_send(buf, len);
 }
 
-void avr_uart_send(const char *s, size_t len) {
+void avr_uart_send_hex8(uint8_t u) {
 
-  while (len--) avr_uart_send_byte(*s++);
+  char buf[2];
+  avr_uart_send(buf, avr_uart_fmt_hex(buf, u, 2));
 }
 
-void avr_uart_pgm_send(PGM_P s) {
+void avr_uart_send_hex16(uint16_t u) {
 
-  for (char c = pgm_read_byte(s); c != 0; c = pgm_read_byte(++s)) {
-    avr_uart_send_byte(c);
-  } 
+  char buf[4];
+  avr_uart_send(buf, avr_uart_fmt_hex(buf, u, 4));
+}
+
+void avr_uart_send_hex32(uint32_t u) {
+
+  char buf[8];
+  avr_uart_send(buf, avr_uart_fmt_hex(buf, u, 8));
 }
 
 void avr_uart_send_uint(unsigned int u) {
 
-#if (__SIZEOF_INT__ == 1)
-  uint8_t digits[4];
-#elif (__SIZEOF_INT__ == 2)
-  uint8_t digits[6];
-#endif
-  uint8_t idx = 0;
+  avr_uart_send_uint16(u);
+}
 
-  if (u == 0) {
-    digits[idx++] = 0;
-  } else {
-    while (u > 0) {
-      digits[idx++] = u % 10;
-      u /= 10;
-    }
+void avr_uart_send_int(int n) {
+
+  avr_uart_send_int16(n);
+}
+
+/*
+ * The value is split into a 32-bit integer part and the fraction scaled by
+ * 10^m and rounded. A fraction rounding up to 10^m carries into the integer
+ * part, so 0.999 with two digits becomes 1.00. With 32-bit double, as on
+ * avr-gcc by default, this is float arithmetic throughout.
+ */
+
+/**
+ * @internal
+ * @brief Format d as fixed point with m decimals, return the characters
+ *
+ * @param buf Buffer of at least UART_FMT_REAL_LEN characters
+ */
+uint8_t avr_uart_fmt_real(char *buf, double d, uint8_t m) {
+
+  uint8_t len = 0;
+
+  if (__builtin_isnan(d)) {
+    memcpy(buf, "nan", 3);
+    return 3;
   }
 
-  while (idx > 0) {
-    avr_uart_send_byte(avr_util_ascii(digits[--idx]));
+  /* Checked on the sign bit, -0.5 would lose it to an integer part of 0 */
+  if (__builtin_signbit(d)) {
+    buf[len++] = '-';
+    d = -d;
   }
-}
 
-void avr_uart_send_int(int n) {
+  if (m > UART_FMT_FRAC_MAX) {
+    m = UART_FMT_FRAC_MAX;
+  }
 
-  if (n < 0) {
-    avr_uart_send_byte('-');
-    n = -n;
+  uint32_t scale = m > 0 ? pgm_read_dword(
+      &uart_pow10_32[sizeof(uart_pow10_32) / sizeof(uart_pow10_32[0]) - m]) :
+    1;
+
+  /* Values whose integer part does not fit 32 bits cannot be fixed point */
+  if (__builtin_isinf(d) || d >= 4294967295.0) {
+    memcpy(buf + len, __builtin_isinf(d) ? "inf" : "ovf", 3);
+    return len + 3;
   }
 
-  avr_uart_send_uint(n);
-}
+  uint32_t ip = (uint32_t)d;
+  uint32_t fp = (uint32_t)((d - (double)ip) * (double)scale + 0.5);
 
-/* TODO: sprintf with -lprintf_flt or dtostrf, but bigger size */
-void avr_uart_send_float(float f, uint8_t m) {
+  if (fp >= scale) {
+    fp -= scale;
+    ip++;
+  }
 
-  /* NOTE: fractional part greater than 4 does not work */
-  if (m > 4) m = 4;
+  len += avr_uart_fmt_u32(buf + len, ip);
 
-  avr_uart_send_int(f);
-  avr_uart_send_byte('.');
+  if (m > 0) {
+    buf[len++] = '.';
 
-  f = f - (int)f;
-  for (uint8_t i = 0; i < m; i++) {
-    f = f * 10;
+    /* Leading zeros of the fraction are significant */
+    char digits[10];
+    uint8_t n = avr_uart_fmt_u32(digits, fp);
+
+    memset(buf + len, '0', m - n);
+    memcpy(buf + len + m - n, digits, n);
+    len += m;
   }
 
-  avr_uart_send_int(f);
+  return len;
+}
+
+void avr_uart_send_float(float f, uint8_t m) {
+
+  char buf[UART_FMT_REAL_LEN];
+  avr_uart_send(buf, avr_uart_fmt_real(buf, f, m));
 }
 
 void avr_uart_send_double(double d, uint8_t m) {
 
+  char buf[UART_FMT_REAL_LEN];
+  avr_uart_send(buf, avr_uart_fmt_real(buf, d, m));
 }
 
 void avr_uart_newline() {
@@ -454,3 +2771,5 @@ void avr_uart_newline() {
 void avr_uart_clear() {
   avr_uart_send(AVR_UTIL_CONSTANT_CLEARSCREEN_STRING, 7);
 }
+
+#endif /* UART_HAS_TX */
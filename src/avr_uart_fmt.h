@@ -0,0 +1,82 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _AVR_UART_FMT_H_
+#define _AVR_UART_FMT_H_
+
+/**
+ * @file avr_uart_fmt.h
+ * @author notweerdmonk
+ * @brief Division-free number formatters shared by avr_uart.c and
+ *        avr_uart_printf.c
+ *
+ * Each formatter writes into buf without a terminator and returns the number
+ * of characters written.
+ *
+ * @internal
+ */
+
+#include <stdint.h>
+
+/**
+ * @internal
+ * @brief Largest number of fractional digits, 10^9 is the largest 32-bit
+ *        power of ten
+ */
+#define UART_FMT_FRAC_MAX 9
+
+/**
+ * @internal
+ * @brief Characters of avr_uart_fmt_real(), sign, 32-bit integer part, point
+ *        and fraction
+ */
+#define UART_FMT_REAL_LEN (1 + 10 + 1 + UART_FMT_FRAC_MAX)
+
+/**
+ * @internal
+ * @brief Format u as decimal, at most 5 characters
+ */
+uint8_t avr_uart_fmt_u16(char *buf, uint16_t u);
+
+/**
+ * @internal
+ * @brief Format u as decimal, at most 10 characters
+ */
+uint8_t avr_uart_fmt_u32(char *buf, uint32_t u);
+
+/**
+ * @internal
+ * @brief Format the low digits nibbles of u as upper case hexadecimal
+ */
+uint8_t avr_uart_fmt_hex(char *buf, uint32_t u, uint8_t digits);
+
+/**
+ * @internal
+ * @brief Format d as fixed point with m decimals, m is clamped to
+ *        UART_FMT_FRAC_MAX
+ *
+ * @param buf Buffer of at least UART_FMT_REAL_LEN characters
+ */
+uint8_t avr_uart_fmt_real(char *buf, double d, uint8_t m);
+
+#endif /* _AVR_UART_FMT_H_ */
@@ -0,0 +1,328 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#ifdef AVR_UART_FRAME
+
+/**
+ * @file avr_uart_frame.c
+ * @author notweerdmonk
+ * @brief Packet framing implementation for UART
+ *
+ * This file implements SLIP and COBS framing. The RX ISR reports every byte
+ * so that frame boundaries are known as soon as the delimiter arrives, the
+ * main loop then decodes complete frames straight out of the RX buffer.
+ *
+ * @note This file is only compiled when AVR_UART_FRAME is defined
+ */
+
+#include <stdint.h>
+#include <avr_uart.h>
+#include <avr_uart_ring.h>
+
+#if (UART_FRAME_ENCODING == UART_FRAME_SLIP)
+
+#define FRAME_END     0xC0
+#define FRAME_ESC     0xDB
+#define FRAME_ESC_END 0xDC
+#define FRAME_ESC_ESC 0xDD
+
+#elif (UART_FRAME_ENCODING == UART_FRAME_COBS)
+
+#define FRAME_END     0x00
+
+#else
+#error Unknown UART_FRAME_ENCODING
+#endif
+
+/* A frame never holds more bytes than the RX buffer */
+typedef __typeof__(__builtin_choose_expr(UART_RX_BUFFER_LEN < 256,
+      (uint8_t)0, (uint16_t)0)) frame_len_t;
+
+#define FRAME_QUEUE_NEXT(i) \
+  ((uint8_t)((i) + 1) == (UART_FRAME_QUEUE_LEN + 1) ? 0 : (uint8_t)((i) + 1))
+
+_Static_assert(UART_FRAME_QUEUE_LEN > 0 && UART_FRAME_QUEUE_LEN < 255,
+    "UART_FRAME_QUEUE_LEN must be between 1 and 254");
+
+/**
+ * @internal
+ * @brief Frame delimiting state
+ *
+ * The ISR owns the frame in progress and the queue in index, the main loop
+ * owns the queue out index. One queue slot is kept free to tell a full
+ * queue from an empty one.
+ */
+static
+struct _uart_frame {
+  frame_len_t len;       /* Bytes of the frame in progress in the RX buffer */
+  uint8_t data  : 1;     /* Frame in progress has more than delimiters */
+  uint8_t error : 1;     /* Frame in progress lost bytes */
+  struct _frame {
+    frame_len_t len;
+    uint8_t error;
+  } queue[UART_FRAME_QUEUE_LEN + 1];
+  volatile uint8_t in;
+  volatile uint8_t out;
+} frame;
+
+_Static_assert(sizeof(frame) == UART_PLAN_SRAM_FRAME,
+    "UART_PLAN_SRAM_FRAME is out of date");
+
+/**
+ * @internal
+ * @brief Queue the frame in progress
+ *
+ * A frame that finds the queue full stays in progress and is reported as
+ * an error together with the frame that follows it.
+ */
+static inline void frame_close(void) {
+
+  uint8_t in = frame.in;
+  uint8_t next = FRAME_QUEUE_NEXT(in);
+
+  if (next == frame.out) {
+    frame.error = 1;
+    return;
+  }
+
+  frame.queue[in].len = frame.len;
+  frame.queue[in].error = frame.error;
+  frame.in = next;
+
+  frame.len = 0;
+  frame.data = 0;
+  frame.error = 0;
+}
+
+void avr_uart_do_frame(uint8_t udr) {
+
+  frame.len++;
+
+  if (udr != FRAME_END) {
+    frame.data = 1;
+  } else if (frame.data) {
+    frame_close();
+  }
+}
+
+void avr_uart_frame_dropped(uint8_t udr) {
+
+  if (udr != FRAME_END) {
+    frame.data = 1;
+    frame.error = 1;
+  } else if (frame.data) {
+    /* The stored bytes are intact, only the delimiter is missing */
+    frame_close();
+  }
+}
+
+void avr_uart_frame_flush(void) {
+
+  frame.len = 0;
+  frame.data = 0;
+  frame.error = 0;
+  frame.in = frame.out = 0;
+}
+
+uint8_t avr_uart_frame_available(void) {
+
+  uint8_t in = frame.in;
+  uint8_t out = frame.out;
+
+  return (in >= out) ? in - out : in + (UART_FRAME_QUEUE_LEN + 1) - out;
+}
+
+size_t avr_uart_frame_recv(char *buf, size_t len) {
+
+  uint8_t out = frame.out;
+
+  UART_WAIT_WHILE(out == frame.in);
+
+  frame_len_t left = frame.queue[out].len;
+  uint8_t error = frame.queue[out].error;
+  size_t n = 0;
+
+#if (UART_FRAME_ENCODING == UART_FRAME_SLIP)
+  uint8_t esc = 0;
+#else
+  uint8_t code = 0xFF;
+  uint8_t run = 0;
+#endif
+
+  while (left) {
+    const char *p;
+    size_t span;
+
+    avr_uart_rx_acquire(&p, &span);
+    if (span > left) {
+      span = left;
+    }
+
+    for (size_t i = 0; i < span; i++) {
+      uint8_t c = p[i];
+
+      if (c == FRAME_END) {
+        continue;
+      }
+
+#if (UART_FRAME_ENCODING == UART_FRAME_SLIP)
+
+      if (esc) {
+        esc = 0;
+        if (c == FRAME_ESC_END) {
+          c = FRAME_END;
+        } else if (c == FRAME_ESC_ESC) {
+          c = FRAME_ESC;
+        } else {
+          error = 1;
+        }
+      } else if (c == FRAME_ESC) {
+        esc = 1;
+        continue;
+      }
+
+#else /* UART_FRAME_COBS */
+
+      if (run == 0) {
+        /* A code byte, every group but a maximal one ends in a zero */
+        uint8_t zero = (code != 0xFF);
+        code = c;
+        run = c - 1;
+        if (!zero) {
+          continue;
+        }
+        c = 0;
+      } else {
+        run--;
+      }
+
+#endif /* UART_FRAME_ENCODING */
+
+      if (n < len) {
+        buf[n] = c;
+      } else {
+        error = 1;
+      }
+      n++;
+    }
+
+    avr_uart_rx_release(span);
+    left -= span;
+  }
+
+#if (UART_FRAME_ENCODING == UART_FRAME_SLIP)
+  error |= esc;
+#else
+  error |= (run != 0);
+#endif
+
+  frame.out = FRAME_QUEUE_NEXT(out);
+
+  return error ? UART_FRAME_ERROR : n;
+}
+
+#if UART_HAS_TX
+
+/**
+ * @internal
+ * @brief Position in the transmit buffer span being written
+ */
+struct _frame_writer {
+  char *ptr;
+  size_t len;
+  size_t used;
+};
+
+/**
+ * @internal
+ * @brief Write one encoded byte, sending the span when it is used up
+ */
+static inline void frame_put(struct _frame_writer *w, uint8_t c) {
+
+  while (w->used == w->len) {
+    avr_uart_tx_commit(w->used);
+    avr_uart_tx_reserve(&w->ptr, &w->len);
+    w->used = 0;
+  }
+
+  w->ptr[w->used++] = c;
+}
+
+void avr_uart_frame_send(const char *buf, size_t len) {
+
+  struct _frame_writer w = { NULL, 0, 0 };
+
+#if (UART_FRAME_ENCODING == UART_FRAME_SLIP)
+
+  /* A leading delimiter flushes any line noise at the receiver */
+  frame_put(&w, FRAME_END);
+
+  while (len--) {
+    uint8_t c = *buf++;
+
+    if (c == FRAME_END) {
+      frame_put(&w, FRAME_ESC);
+      c = FRAME_ESC_END;
+    } else if (c == FRAME_ESC) {
+      frame_put(&w, FRAME_ESC);
+      c = FRAME_ESC_ESC;
+    }
+    frame_put(&w, c);
+  }
+
+#else /* UART_FRAME_COBS */
+
+  size_t i = 0;
+
+  for (;;) {
+    uint8_t run = 0;
+
+    while (i + run < len && buf[i + run] != 0 && run < 254) {
+      run++;
+    }
+
+    frame_put(&w, run + 1);
+    for (uint8_t k = 0; k < run; k++) {
+      frame_put(&w, buf[i + k]);
+    }
+
+    i += run;
+    if (i == len) {
+      break;
+    }
+    if (run < 254) {
+      /* Skip the zero the code byte stands for */
+      i++;
+    }
+  }
+
+#endif /* UART_FRAME_ENCODING */
+
+  frame_put(&w, FRAME_END);
+
+  avr_uart_tx_commit(w.used);
+}
+
+#endif /* UART_HAS_TX */
+
+#endif /* AVR_UART_FRAME */
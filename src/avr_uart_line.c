@@ -0,0 +1,248 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifdef AVR_UART_LINE
+
+/**
+ * @file avr_uart_line.c
+ * @author notweerdmonk
+ * @brief Line discipline implementation for UART
+ *
+ * The RX ISR reports every byte so that line ends are known as soon as they
+ * arrive. Editing keys are applied to the line in progress at the tail of
+ * the RX buffer and the echo is queued for the UDRE ISR, the main loop then
+ * copies complete lines straight out of the RX buffer.
+ *
+ * @note This file is only compiled when AVR_UART_LINE is defined
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr_uart.h>
+
+/**
+ * @internal
+ * @brief RX ISR helpers of avr_uart.c
+ *
+ * avr_uart_line_unput() takes the newest byte back out of the RX ring and
+ * returns 0 if the ring is empty. avr_uart_line_echo() queues bytes for the
+ * UDRE ISR to send ahead of the TX ring, bytes that do not fit are not
+ * echoed.
+ */
+extern uint8_t avr_uart_line_unput(void);
+extern void avr_uart_line_echo(const char *s, uint8_t len);
+
+#define LINE_BS  0x08
+#define LINE_DEL 0x7F
+
+/* A line never holds more bytes than the RX buffer */
+typedef __typeof__(__builtin_choose_expr(UART_RX_BUFFER_LEN < 256,
+      (uint8_t)0, (uint16_t)0)) line_len_t;
+
+#define LINE_QUEUE_NEXT(i) \
+  ((uint8_t)((i) + 1) == (UART_LINE_QUEUE_LEN + 1) ? 0 : (uint8_t)((i) + 1))
+
+_Static_assert(UART_LINE_QUEUE_LEN > 0 && UART_LINE_QUEUE_LEN < 255,
+    "UART_LINE_QUEUE_LEN must be between 1 and 254");
+
+/**
+ * @internal
+ * @brief Line delimiting state
+ *
+ * The ISR owns the line in progress and the queue in index, the main loop
+ * owns the queue out index. One queue slot is kept free to tell a full
+ * queue from an empty one.
+ */
+static
+struct _uart_line {
+  line_len_t len;        /* Bytes of the line in progress in the RX buffer */
+  uint8_t cr    : 1;     /* Last byte was a CR, an LF right after it is skipped */
+  uint8_t error : 1;     /* Line in progress lost bytes */
+  uint8_t mode;
+  struct _line {
+    line_len_t len;      /* Bytes in the RX buffer, the line end included */
+    uint8_t end   : 1;   /* The last byte is the line end */
+    uint8_t error : 1;
+  } queue[UART_LINE_QUEUE_LEN + 1];
+  volatile uint8_t in;
+  volatile uint8_t out;
+} line;
+
+_Static_assert(sizeof(line) == UART_PLAN_SRAM_LINE_STATE,
+    "UART_PLAN_SRAM_LINE_STATE is out of date");
+
+static inline uint8_t line_is_end(uint8_t c) {
+  return c == '\r' || c == '\n';
+}
+
+/**
+ * @internal
+ * @brief Queue the line in progress
+ *
+ * @param end The line end was stored in the RX buffer
+ *
+ * A line that finds the queue full stays in progress and is reported as an
+ * error together with the line that follows it.
+ */
+static inline void line_close(uint8_t end) {
+
+  uint8_t in = line.in;
+  uint8_t next = LINE_QUEUE_NEXT(in);
+
+  if (next == line.out) {
+    line.len += end;
+    line.error = 1;
+    return;
+  }
+
+  line.queue[in].len = line.len + end;
+  line.queue[in].end = end;
+  line.queue[in].error = line.error;
+  line.in = next;
+
+  line.len = 0;
+  line.error = 0;
+}
+
+uint8_t avr_uart_line_filter(uint8_t udr) {
+
+  uint8_t cr = line.cr;
+
+  line.cr = (udr == '\r');
+
+  /* CR LF ends one line */
+  if (udr == '\n' && cr) {
+    return 0;
+  }
+
+  if ((line.mode & UART_LINE_EDIT) && (udr == LINE_BS || udr == LINE_DEL)) {
+    if (line.len > 0 && avr_uart_line_unput()) {
+      line.len--;
+      if (line.mode & UART_LINE_ECHO) {
+        avr_uart_line_echo("\b \b", 3);
+      }
+    }
+    return 0;
+  }
+
+  return 1;
+}
+
+void avr_uart_do_line(uint8_t udr) {
+
+  if (line_is_end(udr)) {
+    if (line.mode & UART_LINE_ECHO) {
+      avr_uart_line_echo("\r\n", 2);
+    }
+    line_close(1);
+    return;
+  }
+
+  line.len++;
+  if (line.mode & UART_LINE_ECHO) {
+    avr_uart_line_echo((const char *)&udr, 1);
+  }
+}
+
+void avr_uart_line_dropped(uint8_t udr) {
+
+  if (!line_is_end(udr)) {
+    line.error = 1;
+    return;
+  }
+
+  /*
+   * The stored bytes are intact, only the line end is missing. With nothing
+   * stored and nothing lost there is no line to queue.
+   */
+  if (line.len || line.error) {
+    line_close(0);
+  }
+}
+
+void avr_uart_line_flush(void) {
+
+  line.len = 0;
+  line.cr = 0;
+  line.error = 0;
+  line.in = line.out = 0;
+}
+
+void avr_uart_line_mode(uint8_t mode) {
+
+  line.mode = mode;
+}
+
+uint8_t avr_uart_line_available(void) {
+
+  uint8_t in = line.in;
+  uint8_t out = line.out;
+
+  return (in >= out) ? in - out : in + (UART_LINE_QUEUE_LEN + 1) - out;
+}
+
+size_t avr_uart_readline(char *buf, size_t max) {
+
+  uint8_t out = line.out;
+
+  if (out == line.in) {
+    return UART_LINE_NONE;
+  }
+
+  line_len_t left = line.queue[out].len;
+  size_t chars = left - line.queue[out].end;
+  uint8_t error = line.queue[out].error || chars >= max;
+  size_t n = 0;
+
+  while (left) {
+    const char *p;
+    size_t span;
+
+    avr_uart_rx_acquire(&p, &span);
+    if (span > left) {
+      span = left;
+    }
+
+    if (!error && n < chars) {
+      size_t k = chars - n < span ? chars - n : span;
+
+      memcpy(buf + n, p, k);
+      n += k;
+    }
+
+    avr_uart_rx_release(span);
+    left -= span;
+  }
+
+  line.out = LINE_QUEUE_NEXT(out);
+
+  if (error) {
+    return UART_LINE_ERROR;
+  }
+
+  buf[n] = '\0';
+
+  return n;
+}
+
+#endif /* AVR_UART_LINE */
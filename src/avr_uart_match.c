@@ -36,51 +36,602 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <avr_uart.h>
+#include <avr_portable.h>
+#include <avr_uart_ring.h>
+
+/* The RX ISR sets UDRIE, so RXCIE is changed atomically, see avr_uart.c */
+#define UART_RXC_MASK()   UART_ATOMIC_RMW(PORT_DISABLE_RXC_INTERRUPT())
+#define UART_RXC_UNMASK() UART_ATOMIC_RMW(PORT_ENABLE_RXC_INTERRUPT())
+
+/* Field widths follow the configured limits, len keeps two flag bits */
+typedef __typeof__(__builtin_choose_expr(UART_MAX_SEQ_LEN < 64,
+      (uint8_t)0, (uint16_t)0)) match_len_t;
+typedef __typeof__(__builtin_choose_expr(UART_MATCH_POOL_LEN < 256,
+      (uint8_t)0, (uint16_t)0)) match_pool_t;
+
+/**
+ * @internal
+ * @brief Number of bytes in the triggered mask, one bit per pattern
+ */
+#define MATCH_MASK_BYTES ((UART_MATCH_MAX + 7) / 8)
+
+_Static_assert(UART_MATCH_MAX > 0 && UART_MATCH_MAX < 255,
+    "UART_MATCH_MAX must be between 1 and 254");
+_Static_assert(UART_MAX_SEQ_LEN > 0 && UART_MAX_SEQ_LEN < 16384,
+    "UART_MAX_SEQ_LEN must be between 1 and 16383");
+_Static_assert(UART_MATCH_POOL_LEN >= 0 && UART_MATCH_POOL_LEN < 65536,
+    "UART_MATCH_POOL_LEN must be between 0 and 65535");
+
+/* Without a pool only flash patterns can be registered */
+#if defined AVR_UART_AUTOMATON_MATCH || UART_MATCH_POOL_LEN > 0
+_Static_assert((uint32_t)UART_MAX_SEQ_LEN <= (uint32_t)UART_MATCH_POOL_LEN,
+    "A UART_MAX_SEQ_LEN pattern does not fit in UART_MATCH_POOL_LEN");
+#endif
 
 /**
  * @internal
  * @brief Pattern match state structure
  *
  * Maintains state for all registered patterns and their match progress.
+ * Pattern bytes are packed without terminators in pool, patterns registered
+ * from flash are read in place. Slots below match_idx_max are in use when
+ * their active bit is set, the ISR only reads active_mask. With
+ * AVR_UART_AUTOMATON_MATCH a new pattern is pending until the automaton
+ * that finds it is swapped in. The bytes of deregistered patterns stay in
+ * pool until a registration runs out of room.
  */
 static
 struct _uart_match {
   uint8_t match_idx_max;
+  match_pool_t pool_used;
+#ifdef AVR_UART_AUTOMATON_MATCH
+  match_pool_t trie_len;   /* Bytes of all active patterns */
+#endif
   struct _match {
-    uint8_t count : 4;
-    uint8_t len   : 4;
-    char seq[UART_MAX_SEQ_LEN];
+    match_len_t count;
+    match_len_t len;     /* Pattern length and MATCH_LEN_* flags */
+    const char *seq;     /* Pattern bytes in pool, or in flash */
+    uint8_t generation;
     void (*event_handler)(void *);
     void *data;
   } match[UART_MATCH_MAX];
-  uint16_t triggered_mask;
+  char pool[UART_MATCH_POOL_LEN];
+  uint8_t active_mask[MATCH_MASK_BYTES];
+  volatile uint8_t triggered_mask[MATCH_MASK_BYTES];
+#ifdef AVR_UART_AUTOMATON_MATCH
+  uint8_t pending_mask[MATCH_MASK_BYTES];  /* Active from the next swap */
+#endif
 } match;
 
-uint8_t avr_uart_register_match(const char *str, avr_uart_match_handler handler,
-    void *data) {
-  if (!handler) {
-    return -1;
+_Static_assert(sizeof(match) == UART_PLAN_SRAM_MATCH_STATE,
+    "UART_PLAN_SRAM_MATCH_STATE is out of date");
+
+/** Pattern bytes are in flash */
+#define MATCH_LEN_PGM ((match_len_t)1 << (sizeof(match_len_t) * 8 - 1))
+/** Handler runs in the RX ISR */
+#define MATCH_LEN_ISR ((match_len_t)(MATCH_LEN_PGM >> 1))
+/** Bits of len that hold the pattern length */
+#define MATCH_LEN_MASK ((match_len_t)(MATCH_LEN_ISR - 1))
+
+/**
+ * @internal
+ * @brief Bit of slot i within its mask byte
+ */
+#define MATCH_BIT(i) ((uint8_t)(1 << ((i) & 7)))
+
+/**
+ * @internal
+ * @brief Check whether slot i holds a registered pattern
+ */
+static inline uint8_t match_is_active(uint8_t i) {
+
+  return match.active_mask[i >> 3] & MATCH_BIT(i);
+}
+
+/**
+ * @internal
+ * @brief Check whether slot i holds a registered or pending pattern
+ */
+static inline uint8_t match_is_used(uint8_t i) {
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+  return (match.active_mask[i >> 3] | match.pending_mask[i >> 3]) &
+    MATCH_BIT(i);
+#else
+  return match_is_active(i);
+#endif
+}
+
+/**
+ * @internal
+ * @brief Length of a registered pattern
+ */
+static inline match_len_t match_len(const struct _match *p_match) {
+
+  return p_match->len & MATCH_LEN_MASK;
+}
+
+/**
+ * @internal
+ * @brief Read byte i of a registered pattern
+ */
+static inline char match_seq_byte(const struct _match *p_match,
+    match_len_t i) {
+
+  return (p_match->len & MATCH_LEN_PGM) ?
+    pgm_read_byte(p_match->seq + i) : p_match->seq[i];
+}
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+
+/**
+ * @internal
+ * @brief Maximum number of trie nodes, one per pattern byte plus the root
+ */
+#define MATCH_NODES_MAX (UART_MATCH_POOL_LEN + 1)
+
+_Static_assert(UART_MATCH_EDGE_MAX > 0 && UART_MATCH_EDGE_MAX < 65536,
+    "UART_MATCH_EDGE_MAX must be between 1 and 65535");
+
+typedef __typeof__(__builtin_choose_expr(MATCH_NODES_MAX < 256,
+      (uint8_t)0, (uint16_t)0)) match_node_t;
+typedef __typeof__(__builtin_choose_expr(UART_MATCH_EDGE_MAX < 256,
+      (uint8_t)0, (uint16_t)0)) match_edge_t;
+
+/**
+ * @internal
+ * @brief Aho-Corasick automaton over the registered patterns
+ *
+ * Each table holds the automaton compiled to a deterministic one. Node 0 is
+ * the root, the edges of node s are edge[first[s]] up to edge[first[s + 1]].
+ * They are every transition out of s except those to depth one nodes, which
+ * are the edges of the root, so a byte costs at most one scan of the edges
+ * of the state and one of the root and never follows a fail link. out is
+ * the first pattern + 1 ending at a node, next_out the next pattern + 1
+ * ending at the same node and dict the nearest node on the fail chain where
+ * a pattern ends.
+ *
+ * The ISR reads table[live], registrations build the other table with the
+ * RXC interrupt enabled and swap it in.
+ */
+static
+struct _uart_automaton {
+  match_node_t state;
+  uint8_t live;
+  struct _match_table {
+    match_edge_t first[MATCH_NODES_MAX + 1];
+    struct _edge {
+      char c;
+      match_node_t to;
+    } edge[UART_MATCH_EDGE_MAX];
+    uint8_t out[MATCH_NODES_MAX];
+    match_node_t dict[MATCH_NODES_MAX];
+    uint8_t next_out[UART_MATCH_MAX];
+  } table[2];
+} automaton;
+
+_Static_assert(sizeof(automaton) == UART_PLAN_SRAM_AUTOMATON,
+    "UART_PLAN_SRAM_AUTOMATON is out of date");
+
+/**
+ * @internal
+ * @brief Find the edge labelled c among the edges of node s
+ *
+ * @return Node the edge leads to, or 0 if there is none
+ */
+static inline match_node_t match_edge(const struct _match_table *t,
+    match_node_t s, char c) {
+
+  for (match_edge_t e = t->first[s]; e != t->first[s + 1]; e++) {
+    if (t->edge[e].c == c) {
+      return t->edge[e].to;
+    }
   }
-  if (match.match_idx_max == UART_MATCH_MAX) {
+
+  return 0;
+}
+
+/**
+ * @internal
+ * @brief Transition out of node s on byte c
+ */
+static inline match_node_t match_next(const struct _match_table *t,
+    match_node_t s, char c) {
+
+  match_node_t n = match_edge(t, s, c);
+
+  return n || !s ? n : match_edge(t, 0, c);
+}
+
+/**
+ * @internal
+ * @brief Append an edge to the edges of node s
+ *
+ * The edges of the nodes after s, up to node count, move up by one.
+ *
+ * @return 0 on success, -1 if the edge table is full
+ */
+static uint8_t match_edge_add(struct _match_table *t, match_node_t count,
+    match_node_t s, char c, match_node_t to) {
+
+  match_edge_t end = t->first[count];
+  match_edge_t pos = t->first[s + 1];
+
+  if (end == UART_MATCH_EDGE_MAX) {
     return -1;
   }
 
-  struct _match *p_match = &match.match[match.match_idx_max];
+  memmove(&t->edge[pos + 1], &t->edge[pos], (end - pos) * sizeof(t->edge[0]));
+  t->edge[pos] = (struct _edge){ .c = c, .to = to };
+
+  for (match_node_t k = s + 1; k <= count; k++) {
+    t->first[k]++;
+  }
+
+  return 0;
+}
+
+/**
+ * @internal
+ * @brief Compile the registered and pending patterns into table t
+ *
+ * @return 0 on success, -1 if the edge table is full
+ *
+ * @note Runs with the RXC interrupt enabled, t is never table[live]
+ */
+static uint8_t match_build(struct _match_table *t) {
+
+  match_node_t count = 1;
+
+  t->first[0] = t->first[1] = 0;
+  t->out[0] = 0;
+
+  /* The trie first, the edges of each node are its children */
+  for (uint8_t i = 0; i < match.match_idx_max; i++) {
+    struct _match *p_match = &match.match[i];
+    match_node_t s = 0;
+
+    if (!match_is_used(i)) {
+      continue;
+    }
+
+    for (match_len_t j = 0; j < match_len(p_match); j++) {
+      char c = match_seq_byte(p_match, j);
+      match_node_t n = match_edge(t, s, c);
+
+      if (!n) {
+        n = count++;
+        t->first[count] = t->first[n];
+        t->out[n] = 0;
+        if (match_edge_add(t, count, s, c, n)) {
+          return -1;
+        }
+      }
+      s = n;
+    }
+
+    t->next_out[i] = t->out[s];
+    t->out[s] = i + 1;
+  }
+
+  /*
+   * Breadth first, so the edges of a fail target are complete before they
+   * are used. A node then takes the edges of its fail target that it has no
+   * child for, unless the fail target is the root.
+   */
+  match_node_t queue[MATCH_NODES_MAX];
+  match_node_t fail[MATCH_NODES_MAX];
+  match_node_t head = 0;
+  match_node_t tail = 0;
+
+  queue[tail++] = 0;
+  fail[0] = 0;
+  t->dict[0] = 0;
+
+  while (head != tail) {
+    match_node_t u = queue[head++];
+    match_edge_t children = t->first[u + 1] - t->first[u];
+
+    for (match_edge_t k = 0; k < children; k++) {
+      const struct _edge *e = &t->edge[t->first[u] + k];
+      match_node_t f = u ? match_next(t, fail[u], e->c) : 0;
+
+      fail[e->to] = f;
+      t->dict[e->to] = t->out[f] ? f : t->dict[f];
+      queue[tail++] = e->to;
+    }
+
+    if (!fail[u]) {
+      continue;
+    }
+
+    /* Adding edges to u moves the edges after it, so index them afresh */
+    match_edge_t inherited = t->first[fail[u] + 1] - t->first[fail[u]];
+
+    for (match_edge_t k = 0; k < inherited; k++) {
+      struct _edge e = t->edge[t->first[fail[u]] + k];
+
+      if (!match_edge(t, u, e.c) && match_edge_add(t, count, u, e.c, e.to)) {
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+#endif /* AVR_UART_AUTOMATON_MATCH */
+
+/**
+ * @internal
+ * @brief Bring the ISR matcher state up to date after patterns changed
+ *
+ * With AVR_UART_AUTOMATON_MATCH the automaton is built with the RXC
+ * interrupt enabled and swapped in with it masked, which makes the pending
+ * patterns active. If the automaton does not fit the pending patterns are
+ * dropped and the ISR keeps the one it had.
+ *
+ * @return 0 on success, -1 if the pending patterns were dropped
+ */
+static uint8_t match_update(void) {
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+  uint8_t ret = match_build(&automaton.table[automaton.live ^ 1]);
+
+  UART_RXC_MASK();
+
+  if (!ret) {
+    automaton.live ^= 1;
+    automaton.state = 0;
+  }
+
+  for (uint8_t i = 0; i < match.match_idx_max; i++) {
+    if (!(match.pending_mask[i >> 3] & MATCH_BIT(i))) {
+      continue;
+    }
+    match.pending_mask[i >> 3] &= ~MATCH_BIT(i);
+    if (ret) {
+      match.trie_len -= match_len(&match.match[i]);
+    } else {
+      match.active_mask[i >> 3] |= MATCH_BIT(i);
+    }
+  }
+
+  UART_RXC_UNMASK();
+
+  return ret;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @internal
+ * @brief Move the bytes of all active pool patterns to the start of pool
+ *
+ * @note Called with the RXC interrupt masked
+ */
+static void match_pool_compact(void) {
+
+  char *dst = &match.pool[0];
+
+  /* Patterns are moved in address order, so nothing is overwritten */
+  for (;;) {
+    struct _match *p_next = NULL;
+
+    for (uint8_t i = 0; i < match.match_idx_max; i++) {
+      struct _match *p_match = &match.match[i];
+
+      if (match_is_used(i) && !(p_match->len & MATCH_LEN_PGM) &&
+          p_match->seq >= dst &&
+          (!p_next || p_match->seq < p_next->seq)) {
+        p_next = p_match;
+      }
+    }
+
+    if (!p_next) {
+      break;
+    }
+
+    memmove(dst, p_next->seq, match_len(p_next));
+    p_next->seq = dst;
+    dst += match_len(p_next);
+  }
+
+  match.pool_used = dst - &match.pool[0];
+}
+
+/**
+ * @internal
+ * @brief Store a pattern in a free match slot
+ *
+ * @param seq     Pattern bytes, in flash with MATCH_LEN_PGM
+ * @param len     Pattern length
+ * @param flags   MATCH_LEN_* flags of the pattern
+ * @param handler Callback function
+ * @param data    User data passed to handler
+ * @return Handle of the slot, or UART_MATCH_HANDLE_INVALID
+ *
+ * @note Called with the RXC interrupt masked, the ISR matcher state is not
+ *       updated and with AVR_UART_AUTOMATON_MATCH the pattern is pending,
+ *       see match_update()
+ */
+static avr_uart_match_handle match_add(const char *seq, size_t len,
+    match_len_t flags, avr_uart_match_handler handler, void *data) {
+
+  if (!handler || len == 0) {
+    return UART_MATCH_HANDLE_INVALID;
+  }
+
   uint8_t i = 0;
+  while (i < match.match_idx_max && match_is_used(i)) {
+    i++;
+  }
+  if (i == UART_MATCH_MAX) {
+    return UART_MATCH_HANDLE_INVALID;
+  }
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+  /* The trie has a node for every byte of every active pattern */
+  if (len > (size_t)(UART_MATCH_POOL_LEN - match.trie_len)) {
+    return UART_MATCH_HANDLE_INVALID;
+  }
+#endif
+
+  uint8_t pgm = !!(flags & MATCH_LEN_PGM);
 
-  while ( (i < UART_MAX_SEQ_LEN) && (*str != '\0') ) {
-    p_match->seq[i++] = *str++;
+  if (!pgm && len > (size_t)(UART_MATCH_POOL_LEN - match.pool_used)) {
+    match_pool_compact();
+    if (len > (size_t)(UART_MATCH_POOL_LEN - match.pool_used)) {
+      return UART_MATCH_HANDLE_INVALID;
+    }
   }
-  p_match->seq[i] = '\0';
-  p_match->len = i;
+
+  struct _match *p_match = &match.match[i];
+
+  if (pgm) {
+    p_match->seq = seq;
+  } else {
+    p_match->seq = memcpy(&match.pool[match.pool_used], seq, len);
+    match.pool_used += len;
+  }
+  p_match->len = len | flags;
+  p_match->count = 0;
+  p_match->generation++;
 
   p_match->event_handler = handler;
   p_match->data = data;
 
-  match.match_idx_max++;
+#ifdef AVR_UART_AUTOMATON_MATCH
+  match.trie_len += len;
+#endif
 
-  return 0;
+  match.triggered_mask[i >> 3] &= ~MATCH_BIT(i);
+#ifdef AVR_UART_AUTOMATON_MATCH
+  match.pending_mask[i >> 3] |= MATCH_BIT(i);
+#else
+  match.active_mask[i >> 3] |= MATCH_BIT(i);
+#endif
+  if (i == match.match_idx_max) {
+    match.match_idx_max++;
+  }
+
+  return ((avr_uart_match_handle)p_match->generation << 8) | i;
+}
+
+avr_uart_match_handle avr_uart_register_match(const char *str,
+    avr_uart_match_handler handler, void *data) {
+
+  size_t len = 0;
+  while ( (len < UART_MAX_SEQ_LEN) && (str[len] != '\0') ) {
+    len++;
+  }
+
+  UART_RXC_MASK();
+
+  avr_uart_match_handle handle = match_add(str, len, 0, handler, data);
+
+  UART_RXC_UNMASK();
+
+  if (handle != UART_MATCH_HANDLE_INVALID && match_update()) {
+    handle = UART_MATCH_HANDLE_INVALID;
+  }
+
+  return handle;
+}
+
+avr_uart_match_handle avr_uart_register_match_P(PGM_P str,
+    avr_uart_match_handler handler, void *data) {
+
+  size_t len = strnlen_P(str, UART_MAX_SEQ_LEN);
+
+  UART_RXC_MASK();
+
+  avr_uart_match_handle handle = match_add(str, len, MATCH_LEN_PGM, handler, data);
+
+  UART_RXC_UNMASK();
+
+  if (handle != UART_MATCH_HANDLE_INVALID && match_update()) {
+    handle = UART_MATCH_HANDLE_INVALID;
+  }
+
+  return handle;
+}
+
+uint8_t avr_uart_register_match_table_P(
+    const struct avr_uart_match_entry *table, uint8_t count) {
+
+  uint8_t ret = 0;
+
+  UART_RXC_MASK();
+
+  for (uint8_t i = 0; i < count; i++) {
+    PGM_P str = pgm_read_ptr(&table[i].str);
+
+    if (match_add(str, strnlen_P(str, UART_MAX_SEQ_LEN), MATCH_LEN_PGM,
+          (avr_uart_match_handler)pgm_read_ptr(&table[i].handler),
+          pgm_read_ptr(&table[i].data)) == UART_MATCH_HANDLE_INVALID) {
+      ret = -1;
+      break;
+    }
+  }
+
+  UART_RXC_UNMASK();
+
+  /* Compile once for the whole table */
+  if (match_update()) {
+    ret = -1;
+  }
+
+  return ret;
+}
+
+#ifdef AVR_UART_ISR_MATCH
+
+avr_uart_match_handle avr_uart_register_match_isr(const char *str,
+    avr_uart_match_handler handler, void *data) {
+
+  size_t len = 0;
+  while ( (len < UART_MAX_SEQ_LEN) && (str[len] != '\0') ) {
+    len++;
+  }
+
+  UART_RXC_MASK();
+
+  avr_uart_match_handle handle =
+    match_add(str, len, MATCH_LEN_ISR, handler, data);
+
+  UART_RXC_UNMASK();
+
+  if (handle != UART_MATCH_HANDLE_INVALID && match_update()) {
+    handle = UART_MATCH_HANDLE_INVALID;
+  }
+
+  return handle;
+}
+
+#endif /* AVR_UART_ISR_MATCH */
+
+void avr_uart_deregister_match_handle(avr_uart_match_handle handle) {
+
+  uint8_t i = handle & 0xFF;
+
+  if (i >= match.match_idx_max || !match_is_active(i) ||
+      match.match[i].generation != (uint8_t)(handle >> 8)) {
+    return;
+  }
+
+  /* A single byte store, the ISR never writes active_mask */
+  match.active_mask[i >> 3] &= ~MATCH_BIT(i);
+
+#ifdef AVR_UART_AUTOMATON_MATCH
+  /* The trie keeps the pattern until the next registration rebuilds it */
+  match.trie_len -= match_len(&match.match[i]);
+#endif
 }
 
 void avr_uart_deregister_match(const char *str) {
@@ -89,70 +640,90 @@ void avr_uart_deregister_match(const char *str) {
     return;
   }
 
-  uint8_t i = 0;
-  uint8_t found = 0;
-
-  for (; i < match.match_idx_max; i++) {
+  for (uint8_t i = 0; i < match.match_idx_max; i++) {
     struct _match *p_match = &match.match[i];
 
-#ifdef AVR_UART_STRNCMP_MATCH
-    if (strncmp(p_match->seq, str, p_match->len) == 0) {
-      found = 1;
-      break;
+    if (!match_is_active(i)) {
+      continue;
     }
+
+#ifdef AVR_UART_STRNCMP_MATCH
+    if (0 == ((p_match->len & MATCH_LEN_PGM) ?
+          strncmp_P(str, p_match->seq, match_len(p_match)) :
+          strncmp(p_match->seq, str, match_len(p_match)))) {
 #else /* !AVR_UART_STRNCMP_MATCH */
     if (0 == ({
           uint8_t ret = 0;
-          size_t n = p_match->len;
-          char *p = &p_match->seq[0];
-          char *q = (char*)&str[0];
+          match_len_t n = 0;
+          const char *q = str;
 
-          while (n--) {
-            if (*p != *q) {
+          for (; n < match_len(p_match); n++) {
+            if (match_seq_byte(p_match, n) != *q) {
               ret = 1;
               break;
             }
-            if (*p == '\0') {
-              break;
-            }
-            p++;
             q++;
           }
+          if (match_len(p_match) < UART_MAX_SEQ_LEN && *q != '\0') {
+            ret = 1;
+          }
           ret;
         })) {
-      found = 1;
-      break;
-    }
 #endif /* AVR_UART_STRNCMP_MATCH */
-  }
-
-  if (found) {
-    for (; i < match.match_idx_max - 1; i++) {
-      match.match[i] = match.match[i+1];
+      avr_uart_deregister_match_handle(
+          ((avr_uart_match_handle)p_match->generation << 8) | i);
+      break;
     }
-    match.match_idx_max--;
   }
 }
 
 void avr_uart_check_match() {
 
-  uint16_t triggered_mask = match.triggered_mask;
-  uint16_t triggered = 1;
+  for (uint8_t j = 0; j < MATCH_MASK_BYTES; j++) {
+    uint8_t triggered = match.triggered_mask[j];
 
-  for (uint8_t i = 0; i < match.match_idx_max; i++) {
-    if (triggered_mask & 1) {
-      struct _match *p_match = &match.match[i];
+    if (!triggered) {
+      continue;
+    }
 
-      if (p_match->event_handler) {
-        (*p_match->event_handler)(p_match->data);
-      }
+    /* Bits set by the ISR between the read and the clear are kept */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      triggered = match.triggered_mask[j];
+      match.triggered_mask[j] = 0;
+    }
+
+    /* Patterns deregistered after they triggered are not dispatched */
+    triggered &= match.active_mask[j];
 
-      match.triggered_mask &= ~triggered;
+    while (triggered) {
+      struct _match *p_match =
+        &match.match[(j << 3) + __builtin_ctz(triggered)];
+
+      triggered &= triggered - 1;
+
+      (*p_match->event_handler)(p_match->data);
     }
+  }
+}
+
+/**
+ * @internal
+ * @brief Report a complete match of slot i
+ *
+ * @note Runs in ISR context
+ */
+static inline void match_trigger(uint8_t i) {
+
+#ifdef AVR_UART_ISR_MATCH
+  struct _match *p_match = &match.match[i];
 
-    triggered_mask = triggered_mask >> 1;
-    triggered = triggered << 1;
+  if (p_match->len & MATCH_LEN_ISR) {
+    (*p_match->event_handler)(p_match->data);
+    return;
   }
+#endif /* AVR_UART_ISR_MATCH */
+
+  match.triggered_mask[i >> 3] |= MATCH_BIT(i);
 }
 
 /**
@@ -167,27 +738,55 @@ void avr_uart_check_match() {
  *
  * @note Runs in ISR context - keeps processing fast and simple
  * @note Uses partial matching - resets on mismatch but restarts if
- *       next byte matches pattern start
+ *       next byte matches pattern start, unless AVR_UART_AUTOMATON_MATCH
+ *       finds every occurrence of every pattern
  */
 void avr_uart_do_match(uint8_t udr) {
 
+#ifdef AVR_UART_AUTOMATON_MATCH
+
+  const struct _match_table *t = &automaton.table[automaton.live];
+  match_node_t s = match_next(t, automaton.state, udr);
+
+  automaton.state = s;
+
+  if (!t->out[s]) {
+    s = t->dict[s];
+  }
+
+  for (; s; s = t->dict[s]) {
+    for (uint8_t out = t->out[s]; out; out = t->next_out[out - 1]) {
+      uint8_t i = out - 1;
+
+      /* The trie keeps deregistered patterns until it is rebuilt */
+      if (match_is_active(i)) {
+        match_trigger(i);
+      }
+    }
+  }
+
+#else /* !AVR_UART_AUTOMATON_MATCH */
+
   if (match.match_idx_max == 0) {
     return;
   }
 
-  uint16_t match_id_mask = 1;
+  const uint8_t *p_active = &match.active_mask[0];
+  uint8_t match_id_mask = 1;
 
   for (uint8_t i = 0; i < match.match_idx_max; i++) {
     struct _match *p_match = &match.match[i];
 
-    if (udr == p_match->seq[p_match->count]) {
-      if (++p_match->count == p_match->len) {
+    if (!(*p_active & match_id_mask)) {
+      /* Free slot */
+    } else if (udr == match_seq_byte(p_match, p_match->count)) {
+      if (++p_match->count == match_len(p_match)) {
         p_match->count = 0;
-        match.triggered_mask |= match_id_mask;
+        match_trigger(i);
         return;
       }
     } else if (p_match->count > 0) {
-      if (udr == p_match->seq[0]) {
+      if (udr == match_seq_byte(p_match, 0)) {
         p_match->count = 1;
       } else {
         p_match->count = 0;
@@ -195,7 +794,13 @@ void avr_uart_do_match(uint8_t udr) {
     }
 
     match_id_mask = match_id_mask << 1;
+    if (!match_id_mask) {
+      match_id_mask = 1;
+      p_active++;
+    }
   }
+
+#endif /* AVR_UART_AUTOMATON_MATCH */
 }
 
 #endif /* AVR_UART_MATCH */
@@ -0,0 +1,341 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifdef AVR_UART_PRINTF
+
+/**
+ * @file avr_uart_printf.c
+ * @author notweerdmonk
+ * @brief Formatted output implementation for UART
+ *
+ * The format string is walked once. Runs of literal text are enqueued with
+ * avr_uart_send(), each conversion is decoded into a spec, formatted into a
+ * stack buffer and enqueued with its padding. Format strings in flash are
+ * read with pgm_read_byte() and copied out in small chunks.
+ *
+ * @note This file is only compiled when AVR_UART_PRINTF is defined
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr_uart.h>
+#include "avr_uart_fmt.h"
+
+/* Bytes copied out of flash per avr_uart_send() */
+#define UART_PRINTF_CHUNK 16
+
+#define PRINTF_FLAG_LEFT 0x01
+#define PRINTF_FLAG_ZERO 0x02
+#define PRINTF_FLAG_LONG 0x04
+#define PRINTF_FLAG_PREC 0x08
+
+/**
+ * @internal
+ * @brief Decoded conversion specification
+ */
+struct _printf_spec {
+  uint8_t flags;
+  uint8_t width;
+  uint8_t prec;
+  char conv;
+};
+
+static inline char printf_read(const char *p, uint8_t pgm) {
+  return pgm ? pgm_read_byte(p) : *p;
+}
+
+/**
+ * @internal
+ * @brief Append decimal digit c to a width or precision, saturating at 255
+ */
+static inline uint8_t printf_digit(uint8_t n, char c) {
+
+  uint16_t v = (uint16_t)n * 10 + (c - '0');
+
+  return v > UINT8_MAX ? UINT8_MAX : v;
+}
+
+/**
+ * @internal
+ * @brief Send len characters from RAM or, in chunks, from flash
+ */
+static void printf_send(const char *s, size_t len, uint8_t pgm) {
+
+  if (!pgm) {
+    avr_uart_send(s, len);
+    return;
+  }
+
+  char chunk[UART_PRINTF_CHUNK];
+
+  while (len > 0) {
+    size_t n = len > sizeof(chunk) ? sizeof(chunk) : len;
+
+    memcpy_P(chunk, s, n);
+    avr_uart_send(chunk, n);
+    s += n;
+    len -= n;
+  }
+}
+
+/**
+ * @internal
+ * @brief Send n copies of c
+ */
+static void printf_pad(char c, uint8_t n) {
+
+  char pad[8];
+
+  memset(pad, c, sizeof(pad));
+
+  while (n > 0) {
+    uint8_t k = n > sizeof(pad) ? sizeof(pad) : n;
+
+    avr_uart_send(pad, k);
+    n -= k;
+  }
+}
+
+/**
+ * @internal
+ * @brief Send a converted field with the padding of its spec
+ *
+ * @return Number of characters sent
+ */
+static int printf_field(const struct _printf_spec *spec, const char *s,
+    size_t len, uint8_t pgm) {
+
+  uint8_t pad = spec->width > len ? spec->width - len : 0;
+  int count = len + pad;
+
+  if (spec->flags & PRINTF_FLAG_LEFT) {
+    printf_send(s, len, pgm);
+    printf_pad(' ', pad);
+  } else if (spec->flags & PRINTF_FLAG_ZERO) {
+
+    /* Zeros go between the sign and the digits */
+    if (len > 0 && !pgm && *s == '-') {
+      avr_uart_send(s, 1);
+      s++;
+      len--;
+    }
+    printf_pad('0', pad);
+    printf_send(s, len, pgm);
+  } else {
+    printf_pad(' ', pad);
+    printf_send(s, len, pgm);
+  }
+
+  return count;
+}
+
+/**
+ * @internal
+ * @brief Decode the conversion specification following a '%'
+ *
+ * @return Pointer past the conversion character
+ */
+static const char *printf_parse(const char *fmt, uint8_t pgm,
+    struct _printf_spec *spec) {
+
+  char c;
+
+  spec->flags = 0;
+  spec->width = 0;
+  spec->prec = 0;
+
+  for (;; fmt++) {
+    c = printf_read(fmt, pgm);
+    if (c == '-') {
+      spec->flags |= PRINTF_FLAG_LEFT;
+    } else if (c == '0') {
+      spec->flags |= PRINTF_FLAG_ZERO;
+    } else {
+      break;
+    }
+  }
+
+  for (; c >= '0' && c <= '9'; c = printf_read(++fmt, pgm)) {
+    spec->width = printf_digit(spec->width, c);
+  }
+
+  if (c == '.') {
+    spec->flags |= PRINTF_FLAG_PREC;
+    for (c = printf_read(++fmt, pgm); c >= '0' && c <= '9';
+        c = printf_read(++fmt, pgm)) {
+      spec->prec = printf_digit(spec->prec, c);
+    }
+  }
+
+  /* int is promoted anyway, so h and hh only matter for the value range */
+  for (; c == 'h' || c == 'l'; c = printf_read(++fmt, pgm)) {
+    if (c == 'l') {
+      spec->flags |= PRINTF_FLAG_LONG;
+    }
+  }
+
+  spec->conv = c;
+
+  return c != '\0' ? fmt + 1 : fmt;
+}
+
+static int uart_vprintf(const char *fmt, uint8_t pgm, va_list ap) {
+
+  int count = 0;
+
+  for (;;) {
+    const char *run = fmt;
+    char c;
+
+    while ((c = printf_read(fmt, pgm)) != '\0' && c != '%') {
+      fmt++;
+    }
+
+    if (fmt > run) {
+      printf_send(run, fmt - run, pgm);
+      count += fmt - run;
+    }
+
+    if (c == '\0') {
+      break;
+    }
+
+    struct _printf_spec spec;
+    char buf[UART_FMT_REAL_LEN];
+    uint8_t len = 0;
+
+    fmt = printf_parse(fmt + 1, pgm, &spec);
+
+    switch (spec.conv) {
+
+      case 'd':
+      case 'i': {
+        int32_t n = spec.flags & PRINTF_FLAG_LONG ?
+          va_arg(ap, long) : va_arg(ap, int);
+
+        if (n < 0) {
+          buf[len++] = '-';
+        }
+        len += avr_uart_fmt_u32(buf + len, n < 0 ? -(uint32_t)n : (uint32_t)n);
+        break;
+      }
+
+      case 'u':
+        len = avr_uart_fmt_u32(buf, spec.flags & PRINTF_FLAG_LONG ?
+            va_arg(ap, unsigned long) : va_arg(ap, unsigned int));
+        break;
+
+      case 'x':
+      case 'X': {
+        uint32_t u = spec.flags & PRINTF_FLAG_LONG ?
+          va_arg(ap, unsigned long) : va_arg(ap, unsigned int);
+        uint8_t digits = 1;
+
+        while (digits < 8 && (u >> (digits * 4)) != 0) {
+          digits++;
+        }
+        len = avr_uart_fmt_hex(buf, u, digits);
+        if (spec.conv == 'x') {
+          for (uint8_t i = 0; i < len; i++) {
+            if (buf[i] >= 'A') {
+              buf[i] |= 0x20;
+            }
+          }
+        }
+        break;
+      }
+
+      case 'c':
+        buf[len++] = (char)va_arg(ap, int);
+        break;
+
+      case 's':
+      case 'S': {
+        const char *s = va_arg(ap, const char *);
+        size_t n = spec.flags & PRINTF_FLAG_PREC ? spec.prec : SIZE_MAX;
+
+        n = spec.conv == 's' ? strnlen(s, n) : strnlen_P(s, n);
+
+        /* Strings are never zero padded */
+        spec.flags &= ~PRINTF_FLAG_ZERO;
+        count += printf_field(&spec, s, n, spec.conv == 'S');
+        continue;
+      }
+
+      case 'f':
+        len = avr_uart_fmt_real(buf, va_arg(ap, double),
+            spec.flags & PRINTF_FLAG_PREC ? spec.prec : 6);
+        break;
+
+      case '\0':
+        continue;
+
+      default:
+        /* %% sends '%', unknown conversions are sent as they are */
+        if (spec.conv != '%') {
+          buf[len++] = '%';
+        }
+        buf[len++] = spec.conv;
+        spec.flags &= ~PRINTF_FLAG_ZERO;
+        break;
+    }
+
+    count += printf_field(&spec, buf, len, 0);
+  }
+
+  return count;
+}
+
+int avr_uart_vprintf(const char *fmt, va_list ap) {
+
+  return uart_vprintf(fmt, 0, ap);
+}
+
+int avr_uart_vprintf_P(PGM_P fmt, va_list ap) {
+
+  return uart_vprintf(fmt, 1, ap);
+}
+
+int avr_uart_printf(const char *fmt, ...) {
+
+  va_list ap;
+
+  va_start(ap, fmt);
+  int count = uart_vprintf(fmt, 0, ap);
+  va_end(ap);
+
+  return count;
+}
+
+int avr_uart_printf_P(PGM_P fmt, ...) {
+
+  va_list ap;
+
+  va_start(ap, fmt);
+  int count = uart_vprintf(fmt, 1, ap);
+  va_end(ap);
+
+  return count;
+}
+
+#endif /* AVR_UART_PRINTF */
@@ -0,0 +1,352 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifdef AVR_UART_RECORD
+
+/**
+ * @file avr_uart_record.c
+ * @author notweerdmonk
+ * @brief Checksummed binary record implementation for UART
+ *
+ * Sent records are written field by field into the transmit buffer and the
+ * CRC is updated on the way, the trailer is appended at the end without a
+ * second walk over the record. The RX ISR updates its own CRC as bytes are
+ * stored and queues each record with its result, the main loop then copies
+ * verified records straight out of the RX buffer.
+ *
+ * @note This file is only compiled when AVR_UART_RECORD is defined
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <avr_uart.h>
+
+/* Fields are sent from their own bytes */
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+    "record fields are sent in host byte order");
+
+#if (UART_RECORD_CRC == UART_RECORD_CRC16)
+
+typedef uint16_t record_crc_t;
+
+/* CRC-16/MODBUS, reflected 0x8005 */
+#define RECORD_CRC_INIT 0xFFFF
+
+/* CRC of each nibble value, the table walks one nibble per step */
+static const uint16_t record_crc_table[16] PROGMEM = {
+  0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+  0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+#define RECORD_CRC_NIBBLE(crc) \
+  (((crc) >> 4) ^ pgm_read_word(&record_crc_table[(crc) & 0x0F]))
+
+#elif (UART_RECORD_CRC == UART_RECORD_CRC8)
+
+typedef uint8_t record_crc_t;
+
+/* Maxim CRC-8, reflected 0x31 */
+#define RECORD_CRC_INIT 0x00
+
+static const uint8_t record_crc_table[16] PROGMEM = {
+  0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+  0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+#define RECORD_CRC_NIBBLE(crc) \
+  (((crc) >> 4) ^ pgm_read_byte(&record_crc_table[(crc) & 0x0F]))
+
+#else
+#error Unknown UART_RECORD_CRC
+#endif
+
+_Static_assert(sizeof(record_crc_t) == UART_RECORD_CRC_LEN,
+    "UART_RECORD_CRC_LEN does not match UART_RECORD_CRC");
+
+static inline record_crc_t record_crc(record_crc_t crc, uint8_t c) {
+
+  crc ^= c;
+  crc = RECORD_CRC_NIBBLE(crc);
+  crc = RECORD_CRC_NIBBLE(crc);
+
+  return crc;
+}
+
+#if UART_HAS_TX
+
+/**
+ * @internal
+ * @brief Record being written and its position in the transmit buffer span
+ */
+static
+struct _record_writer {
+  char *ptr;
+  size_t len;
+  size_t used;
+  record_crc_t crc;
+} writer;
+
+_Static_assert(sizeof(writer) == UART_PLAN_SRAM_RECORD_WRITER,
+    "UART_PLAN_SRAM_RECORD_WRITER is out of date");
+
+/**
+ * @internal
+ * @brief Write bytes and update the CRC, sending spans as they are used up
+ */
+static void record_put(const uint8_t *p, size_t n) {
+
+  struct _record_writer *w = &writer;
+  record_crc_t crc = w->crc;
+
+  while (n--) {
+    uint8_t c = *p++;
+
+    while (w->used == w->len) {
+      avr_uart_tx_commit(w->used);
+      avr_uart_tx_reserve(&w->ptr, &w->len);
+      w->used = 0;
+    }
+
+    w->ptr[w->used++] = c;
+    crc = record_crc(crc, c);
+  }
+
+  w->crc = crc;
+}
+
+void avr_uart_record_begin(void) {
+
+  writer.ptr = NULL;
+  writer.len = 0;
+  writer.used = 0;
+  writer.crc = RECORD_CRC_INIT;
+}
+
+void avr_uart_record_bytes(const void *data, size_t len) {
+
+  record_put(data, len);
+}
+
+void avr_uart_record_u8(uint8_t u) {
+
+  record_put(&u, sizeof(u));
+}
+
+void avr_uart_record_u16(uint16_t u) {
+
+  record_put((const uint8_t *)&u, sizeof(u));
+}
+
+void avr_uart_record_u32(uint32_t u) {
+
+  record_put((const uint8_t *)&u, sizeof(u));
+}
+
+void avr_uart_record_float(float f) {
+
+  record_put((const uint8_t *)&f, sizeof(f));
+}
+
+/* The trailer goes out low byte first, which leaves a zero CRC behind it */
+void avr_uart_record_end(void) {
+
+  record_crc_t crc = writer.crc;
+
+  record_put((const uint8_t *)&crc, sizeof(crc));
+  avr_uart_tx_commit(writer.used);
+  writer.used = writer.len = 0;
+}
+
+#endif /* UART_HAS_TX */
+
+#if UART_HAS_RX
+
+/* A record never holds more bytes than the RX buffer */
+typedef __typeof__(__builtin_choose_expr(UART_RX_BUFFER_LEN < 256,
+      (uint8_t)0, (uint16_t)0)) record_len_t;
+
+#define RECORD_QUEUE_NEXT(i) \
+  ((uint8_t)((i) + 1) == (UART_RECORD_QUEUE_LEN + 1) ? 0 : (uint8_t)((i) + 1))
+
+_Static_assert(UART_RECORD_QUEUE_LEN > 0 && UART_RECORD_QUEUE_LEN < 255,
+    "UART_RECORD_QUEUE_LEN must be between 1 and 254");
+
+/**
+ * @internal
+ * @brief Record checking state
+ *
+ * Records are counted in bytes on the wire, dropped bytes included, so
+ * that a full RX buffer costs the records it hit without moving the
+ * boundaries of the ones after it. The ISR owns the record in progress and
+ * the queue in index, the main loop owns the queue out index. One queue
+ * slot is kept free to tell a full queue from an empty one.
+ */
+static
+struct _uart_record {
+  record_len_t total;    /* Record and trailer length, 0 while disabled */
+  record_len_t count;    /* Bytes of the record in progress on the wire */
+  record_len_t len;      /* Bytes in the RX buffer not yet queued */
+  uint8_t error;         /* Record in progress lost bytes */
+  record_crc_t crc;
+  struct _record {
+    record_len_t len;    /* Bytes in the RX buffer, the trailer included */
+    uint8_t error;       /* Lost bytes or failed the CRC */
+  } queue[UART_RECORD_QUEUE_LEN + 1];
+  volatile uint8_t in;
+  volatile uint8_t out;
+} record;
+
+_Static_assert(sizeof(record) == UART_PLAN_SRAM_RECORD_STATE,
+    "UART_PLAN_SRAM_RECORD_STATE is out of date");
+
+/**
+ * @internal
+ * @brief Account for one byte of the record in progress
+ *
+ * A record that finds the queue full stays in the RX buffer and is
+ * reported as an error together with the record that follows it.
+ */
+static inline void record_next(void) {
+
+  if (++record.count != record.total) {
+    return;
+  }
+
+  uint8_t error = record.error || record.crc != 0;
+  uint8_t in = record.in;
+  uint8_t next = RECORD_QUEUE_NEXT(in);
+
+  record.count = 0;
+  record.crc = RECORD_CRC_INIT;
+
+  if (next == record.out) {
+    record.error = 1;
+    return;
+  }
+
+  record.queue[in].len = record.len;
+  record.queue[in].error = error;
+  record.in = next;
+
+  record.len = 0;
+  record.error = 0;
+}
+
+void avr_uart_do_record(uint8_t udr) {
+
+  if (!record.total) {
+    return;
+  }
+
+  record.len++;
+  record.crc = record_crc(record.crc, udr);
+  record_next();
+}
+
+void avr_uart_record_dropped(uint8_t udr) {
+
+  (void)udr;
+
+  if (!record.total) {
+    return;
+  }
+
+  record.error = 1;
+  record_next();
+}
+
+void avr_uart_record_flush(void) {
+
+  record.count = 0;
+  record.len = 0;
+  record.error = 0;
+  record.crc = RECORD_CRC_INIT;
+  record.in = record.out = 0;
+}
+
+uint8_t avr_uart_record_length(size_t len) {
+
+  /* The whole record has to fit before it can be read out */
+  if (len >= UART_RX_BUFFER_LEN - UART_RECORD_CRC_LEN) {
+    return 0;
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    record.total = len ? len + UART_RECORD_CRC_LEN : 0;
+    avr_uart_flush_rx();
+  }
+
+  return 1;
+}
+
+uint8_t avr_uart_record_available(void) {
+
+  uint8_t in = record.in;
+  uint8_t out = record.out;
+
+  return (in >= out) ? in - out : in + (UART_RECORD_QUEUE_LEN + 1) - out;
+}
+
+size_t avr_uart_record_recv(void *buf, size_t len) {
+
+  uint8_t out = record.out;
+
+  if (out == record.in) {
+    return UART_RECORD_NONE;
+  }
+
+  record_len_t left = record.queue[out].len;
+  size_t chars = record.total - UART_RECORD_CRC_LEN;
+  uint8_t error = record.queue[out].error || chars > len;
+  size_t n = 0;
+
+  while (left) {
+    const char *p;
+    size_t span;
+
+    avr_uart_rx_acquire(&p, &span);
+    if (span > left) {
+      span = left;
+    }
+
+    if (!error && n < chars) {
+      size_t k = chars - n < span ? chars - n : span;
+
+      memcpy((char *)buf + n, p, k);
+      n += k;
+    }
+
+    avr_uart_rx_release(span);
+    left -= span;
+  }
+
+  record.out = RECORD_QUEUE_NEXT(out);
+
+  return error ? UART_RECORD_ERROR : n;
+}
+
+#endif /* UART_HAS_RX */
+
+#endif /* AVR_UART_RECORD */
@@ -33,7 +33,7 @@
  * - Send and receive data over serial port
  * - Automated test execution with pass/fail reporting
  * - Support for pattern matching tests
- * - Configurable serial device
+ * - Configurable serial devices, several boards are tested in parallel
  *
  * @note Requires a connected AVR device running the target test firmware
  *
@@ -41,6 +41,9 @@
  * # Build and run
  * make -C tests/host
  * ./uart_test -d /dev/ttyUSB0
+ *
+ * # One worker per board
+ * ./uart_test -d /dev/ttyACM0 -d /dev/ttyACM1 -d /dev/ttyACM2
  * @endcode
  */
 #include <stdio.h>
@@ -50,10 +53,11 @@
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <termios.h>
-#include <signal.h>
+#include <sys/wait.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <config.h>
 #include <avr_uart_config.h>
@@ -115,6 +119,15 @@
       case 38400:        \
         speed = B38400;  \
         break;           \
+      case 57600:        \
+        speed = B57600;  \
+        break;           \
+      case 115200:       \
+        speed = B115200; \
+        break;           \
+      case 230400:       \
+        speed = B230400; \
+        break;           \
       case 0:            \
       default:           \
         speed = B0;      \
@@ -124,10 +137,47 @@
 
 #define BUFLEN 256
 
+/**
+ * @brief Most serial devices tested in parallel
+ */
+#define MAX_DEVICES 16
+
+/**
+ * @brief Line idle time, in characters, that ends a reception
+ *
+ * A reception that has got some bytes ends once the line has been idle for
+ * this long instead of waiting for its whole timeout.
+ */
+#define SERIAL_IDLE_CHARS 20
+
+/**
+ * @brief Shortest idle time ending a reception
+ *
+ * USB serial adapters deliver bytes in packets a few milliseconds apart.
+ */
+#define SERIAL_IDLE_MIN_US 50000
+
 static struct logger log;
 
+/**
+ * @brief Device prefixed to the log messages of a parallel worker
+ */
+static const char *log_device = NULL;
+
+/**
+ * @brief Line idle time ending a reception, set with the line settings
+ */
+static int64_t serial_idle_us = SERIAL_IDLE_MIN_US;
+
 static const char okstr[] = "recv OK";
 
+#ifdef AVR_UART_BENCHMARK
+/**
+ * @brief File the benchmark results are appended to, stdout if NULL
+ */
+static const char *bench_output = NULL;
+#endif
+
 static const char teststring[] = { 
   'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
   'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 'A', 'B', 'C', 'D',
@@ -148,6 +198,9 @@ void log_writer(const char *msg, enum logger_level lvl) {
     return;
   }
   FILE *fptr = lvl > LOGGER_INFO ? stderr : stdout;
+  if (log_device) {
+    fprintf(fptr, "[%s] ", log_device);
+  }
   for (; msg && *msg; ++msg) {
     if (isprint(*msg) || iscntrl(*msg)) {
       putc(*msg, fptr);
@@ -158,73 +211,13 @@ void log_writer(const char *msg, enum logger_level lvl) {
   putc('\n', fptr);
 }
 
-static int __stop = 0;
-
-/**
- * @brief Signal alarm handler
- *
- * Signal handler for SIGALRM used to implement timeouts
- * during serial operations.
- *
- * @param sig Signal number (unused)
- */
-void sigalarm_handler(int sig __attribute__ ((unused))) {
-  __stop = 1;
-}
-
 /**
- * @brief Setup alarm signal handler
- *
- * Configures the SIGALRM signal handler for timeout functionality.
- *
- * @param p_old_sa Pointer to store old signal action
- * @return 0 on success, -1 on failure
+ * @brief Monotonic time in microseconds
  */
-int setup_alarm(struct sigaction* p_old_sa) {
-  if (!p_old_sa) {
-    return -1;
-  }
-
-  struct sigaction sa;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_handler = sigalarm_handler;
-  sa.sa_flags = 0;
-  if (sigaction(SIGALRM, &sa, p_old_sa) == -1) {
-    LOG(
-        &log,
-        LOGGER_ERROR,
-        "Sigaction: setting handler for SIGALARM failed: %s",
-        strerror(errno)
-      );
-    return -1;
-  }
-
-  return 0;
-}
-
-/**
- * @brief Cleanup alarm signal handler
- *
- * Restores the previous SIGALRM signal handler.
- *
- * @param p_old_sa Pointer to old signal action to restore
- * @return 0 on success, -1 on failure
- */
-int cleanup_alarm(struct sigaction* p_old_sa) {
-  if (!p_old_sa) {
-    return -1;
-  }
-
-  if (sigaction(SIGALRM, p_old_sa, 0) == -1) {
-    LOG(
-        &log,
-        LOGGER_ERROR,
-        "Sigaction: restoring handler for SIGALARM failed: %s",
-        strerror(errno)
-      );
-    return -1;
-  }
-  return 0;
+static int64_t monotonic_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 /**
@@ -290,31 +283,52 @@ char* parity_type_to_str(int parity) {
  * @param argc Argument count
  * @param argv Argument vector
  * @param k    Pointer to store keep-going flag
- * @param buffer Buffer to store device path
- * @param len   Buffer length
+ * @param devices Array to store the device paths, MAX_DEVICES entries
+ * @param ndevices Pointer to store the number of devices
  * @return 0 on success, -1 on error (including -h flag)
  */
-int parse_cmd_args(int argc, char *argv[], int *k, char *buffer, size_t len) {
+int parse_cmd_args(int argc, char *argv[], int *k, const char **devices,
+    int *ndevices) {
 
   int c;
 
   (void)(k && (*k = 0));
 
-  while ((c = getopt(argc, argv, ":hd:k")) != -1) {
+#ifdef AVR_UART_BENCHMARK
+  const char *optstring = ":hd:ko:";
+#else
+  const char *optstring = ":hd:k";
+#endif
+
+  while ((c = getopt(argc, argv, optstring)) != -1) {
     switch (c) {
       case 'd':
-        strncpy(buffer, optarg, len);
+        if (*ndevices == MAX_DEVICES) {
+          fprintf(stderr, "At most %d devices can be tested\n", MAX_DEVICES);
+          return -1;
+        }
+        devices[(*ndevices)++] = optarg;
         break;
 
       case 'k':
         (void)(k && (*k = 1));
         break;
 
+#ifdef AVR_UART_BENCHMARK
+      case 'o':
+        bench_output = optarg;
+        break;
+#endif
+
       case 'h':
         printf("Usage: %s [OPTION] ...\n", argv[0]);
         printf("  -h             Display this message\n");
-        printf("  -d [device]    Open device as serial port\n");
+        printf("  -d [device]    Open device as serial port, repeat to test "
+            "boards in parallel\n");
         printf("  -k             Keep going in case of failure\n");
+#ifdef AVR_UART_BENCHMARK
+        printf("  -o [file]      Append benchmark results to file\n");
+#endif
         return -1;
 
       case '?':
@@ -347,7 +361,8 @@ int open_serial_device(const char *device) {
 
   LOG(&log, LOGGER_INFO, "Opening device: %s", device);
 
-  int serdev = open(device, O_RDWR|O_NOCTTY);
+  /* Reads and writes never block, serial_wait() polls for readiness */
+  int serdev = open(device, O_RDWR|O_NOCTTY|O_NONBLOCK);
   if (serdev == -1) {
     LOG(&log, LOGGER_ERROR, "Could not open device %s: %s", device,
         strerror(errno));
@@ -394,13 +409,18 @@ int setup_serial_device(int serdev, void *param) {
 
 #else /* !AVR_UART_RUNTIME_CONFIG */
 
-  baud_rate = UART_BAUD_DEFAULT;
+  baud_rate = UART_BAUD_RATE;
   char_size = UART_CHAR_SIZE;
   stop_bits = UART_STOP_BITS;
   parity = UART_PARITY;
 
 #endif /* AVR_UART_RUNTIME_CONFIG */
 
+  /* The target falls back to the default in the same way */
+  if (baud_rate == 0) {
+    baud_rate = UART_BAUD_DEFAULT;
+  }
+
   struct termios settings;
   tcgetattr(serdev, &settings);
 
@@ -441,9 +461,18 @@ int setup_serial_device(int serdev, void *param) {
 
   settings.c_oflag &= ~(OPOST | ONLCR);
 
+  /* Reads return what has arrived, the idle time is kept by poll() */
   settings.c_cc[VMIN] = 0;
   settings.c_cc[VTIME] = 0;
 
+  int bits = 1 + char_size + (stop_bits < 2 ? 1 : 2) +
+    (parity > UART_PARITY_NONE);
+
+  serial_idle_us = (int64_t)SERIAL_IDLE_CHARS * bits * 1000000 / baud_rate;
+  if (serial_idle_us < SERIAL_IDLE_MIN_US) {
+    serial_idle_us = SERIAL_IDLE_MIN_US;
+  }
+
   if (tcsetattr(serdev, TCSANOW, &settings) == -1) {
     LOG(&log, LOGGER_ERROR, "Failed to set serial port attributes!");
     close(serdev);
@@ -454,20 +483,57 @@ int setup_serial_device(int serdev, void *param) {
         LOGGER_INFO,
         "Serial port settings: %d Baud rate, %d-bits Character size, %d "
         "Stop bit, %s parity",
-        UART_BAUD_DEFAULT,
-        UART_CHAR_SIZE,
-        UART_STOP_BITS,
-        parity_type_to_str(UART_PARITY)
+        baud_rate,
+        char_size,
+        stop_bits,
+        parity_type_to_str(parity)
       );
   }
 
   return 0;;
 }
 
+/**
+ * @brief Wait until the serial port is ready or a deadline passes
+ *
+ * @param serdev   File descriptor of serial port
+ * @param events   POLLIN or POLLOUT
+ * @param deadline Monotonic time in microseconds to give up at
+ * @return 1 when ready, 0 on timeout, -1 on error
+ */
+static int serial_wait(int serdev, short events, int64_t deadline) {
+
+  for (;;) {
+    int64_t left = deadline - monotonic_us();
+
+    if (left <= 0) {
+      return 0;
+    }
+
+    struct pollfd pfd = { .fd = serdev, .events = events };
+    int ret = poll(&pfd, 1, (left + 999) / 1000);
+
+    if (ret > 0) {
+      if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        LOG(&log, LOGGER_ERROR, "Serial port closed or failed");
+        return -1;
+      }
+      return 1;
+    }
+
+    if (ret < 0 && errno != EINTR) {
+      LOG(&log, LOGGER_ERROR, "Poll on serial port failed: %s",
+          strerror(errno));
+      return -1;
+    }
+  }
+}
+
 /**
  * @brief Send data over serial port
  *
- * Sends data with timeout support using select() for non-blocking I/O.
+ * Writes as the port accepts data until all of it is sent or the timeout
+ * expires.
  *
  * @param serdev  File descriptor of serial port
  * @param data    Data buffer to send
@@ -478,50 +544,30 @@ int setup_serial_device(int serdev, void *param) {
 size_t serial_send(int serdev, const char *data, size_t len,
     unsigned int timeout) {
 
-  size_t remaining = len;
+  int64_t deadline = monotonic_us() + (int64_t)timeout * 1000000;
   size_t next_byte = 0;
-  ssize_t bytes_count;
-
-  __stop = 0;
 
   LOG(&log, LOGGER_DEBUG, "Sending data:\n%.*s", (int)len, data);
 
-  alarm(timeout);
-
-  do {
-    fd_set wfds;
-    FD_ZERO(&wfds);
-    FD_SET(serdev, &wfds);
+  while (next_byte < len) {
+    int ready = serial_wait(serdev, POLLOUT, deadline);
 
-    struct timeval select_timeout;
-    select_timeout.tv_sec = 0;
-    select_timeout.tv_usec = 1000;
-
-    if (select(serdev + 1, NULL, &wfds, NULL, &select_timeout) > 0) {
+    if (ready < 0) {
+      return -1;
+    } else if (ready == 0) {
+      break;
+    }
 
-      bytes_count = write(serdev, data + next_byte, remaining);
-      if (bytes_count >= 0) {
-        next_byte += bytes_count;
-        remaining -= bytes_count;
-        continue;
-      }
+    ssize_t bytes_count = write(serdev, data + next_byte, len - next_byte);
 
+    if (bytes_count >= 0) {
+      next_byte += bytes_count;
+    } else if (errno != EAGAIN && errno != EINTR) {
       LOG(&log, LOGGER_ERROR, "Write to serial port failed: %s",
           strerror(errno));
-
-      if (errno == EINTR) {
-        __stop = 0;
-        alarm(timeout);
-        continue;
-      }
-
-      alarm(0);
       return -1;
     }
-
-  } while ( !__stop && (next_byte < len) );
-
-  alarm(0);
+  }
 
   LOG(&log, LOGGER_INFO, "Sent %ld bytes", next_byte);
 
@@ -531,10 +577,11 @@ size_t serial_send(int serdev, const char *data, size_t len,
 /**
  * @brief Receive data over serial port
  *
- * Receives data with timeout support using select() for non-blocking I/O.
+ * Reads until len bytes have arrived, the timeout expires or, once some
+ * bytes have arrived, the line has been idle for serial_idle_us.
  *
  * @param serdev  File descriptor of serial port
- * @param buffer  Buffer to store received data
+ * @param buffer  Buffer to store received data, len + 1 bytes
  * @param len     Maximum bytes to receive
  * @param timeout Timeout in seconds
  * @return Number of bytes received, or -1 on error
@@ -542,48 +589,30 @@ size_t serial_send(int serdev, const char *data, size_t len,
 size_t serial_recv(int serdev, char *buffer, size_t len,
     unsigned int timeout) {
 
-  size_t remaining = len;
+  int64_t deadline = monotonic_us() + (int64_t)timeout * 1000000;
   size_t next_byte = 0;
-  ssize_t bytes_count;
-
-  __stop = 0;
-
-  alarm(timeout);
 
-  do {
-    fd_set wfds;
-    FD_ZERO(&wfds);
-    FD_SET(serdev, &wfds);
+  while (next_byte < len) {
+    int64_t idle = monotonic_us() + serial_idle_us;
+    int ready = serial_wait(serdev, POLLIN,
+        next_byte > 0 && idle < deadline ? idle : deadline);
 
-    struct timeval select_timeout;
-    select_timeout.tv_sec = 0;
-    select_timeout.tv_usec = 1000;
-
-    if (select(serdev + 1, NULL, &wfds, NULL, &select_timeout) > 0) {
+    if (ready < 0) {
+      return -1;
+    } else if (ready == 0) {
+      break;
+    }
 
-      bytes_count = read(serdev, buffer + next_byte, remaining);
-      if (bytes_count >= 0) {
-        next_byte += bytes_count;
-        remaining -= bytes_count;
-        continue;
-      }
+    ssize_t bytes_count = read(serdev, buffer + next_byte, len - next_byte);
 
+    if (bytes_count >= 0) {
+      next_byte += bytes_count;
+    } else if (errno != EAGAIN && errno != EINTR) {
       LOG(&log, LOGGER_ERROR, "Read from serial port failed: %s",
           strerror(errno));
-
-      if (errno == EINTR) {
-        __stop = 0;
-        alarm(timeout);
-        continue;
-      }
-
-      alarm(0);
       return -1;
     }
-
-  } while ( !__stop && (next_byte < len) );
-
-  alarm(0);
+  }
 
   buffer[next_byte] = '\0';
   LOG(&log, LOGGER_DEBUG, "Received %ld bytes:\n%s", next_byte, buffer);
@@ -729,6 +758,221 @@ int partial_recv_test(int nargs, ...) {
   return 0;
 }
 
+#ifdef AVR_UART_TIMEOUT
+/**
+ * @brief Test UART reception with timeout
+ *
+ * Tests that a timed receive returns what has arrived once the timeout
+ * expires instead of blocking for the full request.
+ * GIVEN AVR microcontroller WHEN host sends only half a string and uC
+ * requests all of it with a timeout THEN only the half should be returned
+ *
+ * @param nargs Number of arguments
+ * @return 0 on success (test passed), -1 on failure
+ */
+int timeout_recv_test(int nargs, ...) {
+
+  /*
+   * GIVEN AVR microcontroller
+   * WHEN uC waits to recieve a full string with a timeout, the host sends
+   * only half of it and uC sends "recv OK" if exactly that half was returned
+   * and "recv ER" otherwise
+   * THEN "recv OK" should be recieved
+   */
+
+  UNPACK_ARGS(args, nargs);
+
+  serial_send(serdev, teststring, sizeof(teststring) / 2, 3);
+
+  serial_recv(serdev, buffer, sizeof(okstr) - 1, 4);
+
+  if (strncmp(buffer, okstr, sizeof(okstr) - 1)) {
+    return -1;
+  }
+
+  return 0;
+}
+#endif /* AVR_UART_TIMEOUT */
+
+#ifdef AVR_UART_TX_DESC
+/**
+ * @brief Test transmission of queued blocks
+ *
+ * Tests that blocks sent from RAM and flash by the UDRE ISR keep their place
+ * among the bytes of the TX buffer.
+ * GIVEN AVR microcontroller WHEN uC queues part of a string in the TX buffer
+ * and the rest as a RAM and a flash block THEN the whole string should be
+ * received in order
+ *
+ * @param nargs Number of arguments
+ * @return 0 on success (test passed), -1 on failure
+ */
+int desc_send_test(int nargs, ...) {
+
+  /*
+   * GIVEN AVR microcontroller
+   * WHEN uC sends "re" through the TX buffer, "cv " as a RAM block and "OK"
+   * as a flash block
+   * THEN "recv OK" should be recieved
+   */
+
+  UNPACK_ARGS(args, nargs);
+
+  serial_recv(serdev, buffer, sizeof(okstr) - 1, 1);
+
+  if (strncmp(buffer, okstr, sizeof(okstr) - 1)) {
+    return -1;
+  }
+
+  return 0;
+}
+#endif /* AVR_UART_TX_DESC */
+
+#ifdef AVR_UART_RECORD
+/**
+ * @brief Record payload, with bytes that need escaping in other protocols
+ */
+static const char recordstr[8] = {
+  'r', 'e', 'c', 0x00, 0x11, 0x13, (char)0xc0, (char)0xff };
+
+/**
+ * @brief Append the CRC trailer of UART_RECORD_CRC, bit by bit
+ *
+ * @return Record length with the trailer
+ */
+static size_t record_seal(char *record, size_t len) {
+
+#if (UART_RECORD_CRC == UART_RECORD_CRC8)
+  uint16_t crc = 0x00, poly = 0x8c;
+  size_t trailer = 1;
+#else
+  uint16_t crc = 0xffff, poly = 0xa001;
+  size_t trailer = 2;
+#endif
+
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint8_t)record[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+    }
+  }
+
+  for (size_t i = 0; i < trailer; i++) {
+    record[len + i] = (char)(crc >> (8 * i));
+  }
+
+  return len + trailer;
+}
+
+/**
+ * @brief Test checked records in both directions
+ *
+ * Tests that the RX ISR verifies the CRC of received records and that the
+ * record writer appends a valid CRC.
+ * GIVEN AVR microcontroller WHEN the host sends a record and a corrupted
+ * copy THEN uC should accept the first, reject the second and send the
+ * first back with a valid CRC
+ *
+ * @param nargs Number of arguments
+ * @return 0 on success (test passed), -1 on failure
+ */
+int record_test(int nargs, ...) {
+
+  /*
+   * GIVEN AVR microcontroller
+   * WHEN uC is ready, the host sends a record and a copy with a flipped bit,
+   * uC sends the record back and "recv OK" if only the copy was rejected
+   * THEN the record with the same trailer and "recv OK" should be recieved
+   */
+
+  UNPACK_ARGS(args, nargs);
+
+  char record[sizeof(recordstr) + 2];
+  char reply[sizeof(record)];
+
+  memcpy(record, recordstr, sizeof(recordstr));
+  size_t len = record_seal(record, sizeof(recordstr));
+
+  /* Sent once uC has set the record length */
+  serial_recv(serdev, buffer, sizeof(okstr) - 1, 2);
+  if (strncmp(buffer, okstr, sizeof(okstr) - 1)) {
+    return -1;
+  }
+
+  serial_send(serdev, record, len, 1);
+  record[1] ^= 0x01;
+  serial_send(serdev, record, len, 1);
+  record[1] ^= 0x01;
+
+  if (serial_recv(serdev, reply, len, 2) != len ||
+      memcmp(reply, record, len)) {
+    return -1;
+  }
+
+  serial_recv(serdev, buffer, sizeof(okstr) - 1, 1);
+
+  if (strncmp(buffer, okstr, sizeof(okstr) - 1)) {
+    return -1;
+  }
+
+  return 0;
+}
+#endif /* AVR_UART_RECORD */
+
+#ifdef AVR_UART_PRINTF
+/**
+ * @brief Expected output of the format string sent by uC
+ */
+static const char printfstr[] =
+  "[-42  |-0007|beef|1234ABCD|abc|flash|z|%|3.14|-100000|%q]";
+
+/**
+ * @brief Test the format parser of avr_uart_printf
+ *
+ * Tests flags, widths, precisions, length modifiers and every conversion,
+ * that unknown conversions are printed as is and that widths above 255 are
+ * clamped.
+ * GIVEN AVR microcontroller WHEN uC prints a format string using every
+ * conversion and one with a width of 300 THEN the formatted text should be
+ * received, the second padded to 255 characters
+ *
+ * @param nargs Number of arguments
+ * @return 0 on success (test passed), -1 on failure
+ */
+int printf_test(int nargs, ...) {
+
+  /*
+   * GIVEN AVR microcontroller
+   * WHEN uC prints "[%-5d|%05d|%x|%08lX|%.3s|%S|%c|%%|%.2f|%ld|%q]" and
+   * "%300c"
+   * THEN printfstr, 254 spaces and '|' should be recieved
+   */
+
+  UNPACK_ARGS(args, nargs);
+
+  char reply[255];
+
+  if (serial_recv(serdev, buffer, sizeof(printfstr) - 1, 2) !=
+      sizeof(printfstr) - 1 ||
+      memcmp(buffer, printfstr, sizeof(printfstr) - 1)) {
+    return -1;
+  }
+
+  if (serial_recv(serdev, reply, sizeof(reply), 2) != sizeof(reply) ||
+      reply[sizeof(reply) - 1] != '|') {
+    return -1;
+  }
+
+  for (size_t i = 0; i < sizeof(reply) - 1; i++) {
+    if (reply[i] != ' ') {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+#endif /* AVR_UART_PRINTF */
+
 /**
  * @brief Pattern match data structure
  */
@@ -793,37 +1037,324 @@ int match_test(int nargs, ...) {
 }
 #endif
 
+#ifdef AVR_UART_BENCHMARK
+
 /**
- * @brief Main test driver entry point
+ * @brief Mask of the bits a character carries with UART_CHAR_SIZE
+ */
+#define BENCH_CHAR_MASK ((1 << UART_CHAR_SIZE) - 1)
+
+/**
+ * @brief Number of single byte round trips of the echo benchmark
+ */
+#define BENCH_ECHO_ROUNDS 200
+
+/**
+ * @brief Number of consumer loads the burst benchmark runs with
+ */
+#define BENCH_BURST_LOADS 2
+
+/**
+ * @brief Benchmark results of one UART configuration
+ */
+struct bench_result {
+  double stream_bytes_per_s;    /**< Sustained target to host payload rate */
+  double stream_efficiency;     /**< Fraction of the line rate */
+  size_t stream_errors;         /**< Bytes out of sequence or missing */
+  double echo_us[BENCH_ECHO_ROUNDS]; /**< Sorted round trip times */
+  size_t echo_count;            /**< Round trips that came back */
+  struct {
+    unsigned int load_us;       /**< Target work per received byte */
+    size_t sent;                /**< Bytes sent by the host */
+    size_t received;            /**< Bytes the target read */
+    size_t errors;              /**< Bytes the target saw out of sequence */
+  } burst[BENCH_BURST_LOADS];
+};
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+static double bench_now_us(void) {
+  return monotonic_us();
+}
+
+/**
+ * @brief Line rate in characters per second
+ */
+static double bench_line_rate(void) {
+  int bits = 1 + UART_CHAR_SIZE + UART_STOP_BITS +
+    (UART_PARITY != UART_PARITY_NONE);
+  return (double)UART_BAUD_RATE / bits;
+}
+
+/**
+ * @brief Read up to len bytes until timeout_us passes without a byte
+ *
+ * @param t_first Stores the time the first byte arrived, may be NULL
+ * @param t_last  Stores the time the last byte arrived, may be NULL
+ * @return Number of bytes read
+ */
+static size_t bench_read(int serdev, char *buf, size_t len, double timeout_us,
+    double *t_first, double *t_last) {
+
+  size_t count = 0;
+  double last = bench_now_us();
+
+  while (count < len &&
+      serial_wait(serdev, POLLIN, last + timeout_us) > 0) {
+    ssize_t n = read(serdev, buf + count, len - count);
+
+    if (n > 0) {
+      last = bench_now_us();
+      if (count == 0 && t_first) {
+        *t_first = last;
+      }
+      count += n;
+    }
+  }
+
+  if (t_last) {
+    *t_last = last;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Send a benchmark command
+ */
+static void bench_command(int serdev, const char *fmt, ...) {
+  char cmd[32];
+  va_list ap;
+
+  va_start(ap, fmt);
+  int len = vsnprintf(cmd, sizeof(cmd), fmt, ap);
+  va_end(ap);
+
+  serial_send(serdev, cmd, len, 1);
+}
+
+/**
+ * @brief Measure the sustained target to host rate
  *
- * Main function that orchestrates all UART tests:
+ * The target streams about two seconds of a counting sequence, the rate is
+ * taken from the first to the last byte so command latency is left out.
+ */
+static void bench_stream(int serdev, struct bench_result *res) {
+
+  size_t n = (size_t)(bench_line_rate() * 2);
+  char *buf = malloc(n);
+  double t_first = 0, t_last = 0;
+
+  if (!buf) {
+    return;
+  }
+
+  bench_command(serdev, "S%zu\n", n);
+  size_t count = bench_read(serdev, buf, n, 1e6, &t_first, &t_last);
+
+  res->stream_errors = n - count;
+  for (size_t i = 0; i < count; i++) {
+    if (((unsigned char)buf[i] & BENCH_CHAR_MASK) != (i & BENCH_CHAR_MASK)) {
+      res->stream_errors++;
+    }
+  }
+
+  if (count > 1 && t_last > t_first) {
+    res->stream_bytes_per_s = (count - 1) / ((t_last - t_first) / 1e6);
+    res->stream_efficiency = res->stream_bytes_per_s / bench_line_rate();
+  }
+
+  free(buf);
+}
+
+static int bench_cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Measure single byte round trips
+ */
+static void bench_echo(int serdev, struct bench_result *res) {
+
+  size_t lost = 0;
+
+  bench_command(serdev, "E%d\n", BENCH_ECHO_ROUNDS);
+
+  for (int i = 0; i < BENCH_ECHO_ROUNDS; i++) {
+    char c = i & BENCH_CHAR_MASK;
+    char r;
+    double t0 = bench_now_us();
+
+    serial_send(serdev, &c, 1, 1);
+    if (bench_read(serdev, &r, 1, 100000, NULL, NULL) == 1) {
+      res->echo_us[res->echo_count++] = bench_now_us() - t0;
+    } else {
+      lost++;
+    }
+  }
+
+  /* A lost byte leaves the target waiting, feed it so it takes commands */
+  while (lost-- > 0) {
+    char c = 0;
+    serial_send(serdev, &c, 1, 1);
+  }
+  bench_read(serdev, (char[BUFLEN]){ 0 }, BUFLEN, 200000, NULL, NULL);
+
+  qsort(res->echo_us, res->echo_count, sizeof(double), bench_cmp_double);
+}
+
+/**
+ * @brief Send bursts at the line rate and count what the target kept
+ *
+ * The first burst is drained as fast as the target can, the second with
+ * two character times of work per byte, which overflows the RX buffer.
+ */
+static void bench_burst(int serdev, struct bench_result *res) {
+
+  size_t n = (size_t)bench_line_rate();
+  char *buf = malloc(n);
+  char reply[64];
+
+  if (!buf) {
+    return;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    buf[i] = i & BENCH_CHAR_MASK;
+  }
+
+  for (int k = 0; k < BENCH_BURST_LOADS; k++) {
+    unsigned int load_us = k * (unsigned int)(2e6 / bench_line_rate());
+    unsigned long received = 0, errors = 0;
+
+    bench_command(serdev, "B%zu,%u\n", n, load_us);
+    size_t sent = serial_send(serdev, buf, n, 10);
+
+    /* The target reports once it has worked through the whole burst */
+    double timeout_us = n * (load_us + 1e6 / bench_line_rate()) + 1e6;
+    size_t len = bench_read(serdev, reply, sizeof(reply) - 1, timeout_us,
+        NULL, NULL);
+    reply[len] = '\0';
+    sscanf(reply, "%lu %lu", &received, &errors);
+
+    res->burst[k].load_us = load_us;
+    res->burst[k].sent = sent;
+    res->burst[k].received = received;
+    res->burst[k].errors = errors;
+  }
+
+  free(buf);
+}
+
+/**
+ * @brief Percentile of the sorted echo round trips
+ */
+static double bench_echo_percentile(const struct bench_result *res,
+    double q) {
+  if (res->echo_count == 0) {
+    return 0;
+  }
+  return res->echo_us[(size_t)(q * (res->echo_count - 1))];
+}
+
+/**
+ * @brief Append the results as one JSON object per line
+ *
+ * @return 0 on success, -1 if the output file cannot be opened
+ */
+static int bench_write(const struct bench_result *res) {
+
+  FILE *f = bench_output ? fopen(bench_output, "a") : stdout;
+
+  if (!f) {
+    LOG(&log, LOGGER_ERROR, "Could not open %s: %s", bench_output,
+        strerror(errno));
+    return -1;
+  }
+
+  fprintf(f,
+      "{\"baud\":%d,\"char_size\":%d,\"stop_bits\":%d,\"parity\":\"%s\","
+      "\"rx_buffer_len\":%d,\"tx_buffer_len\":%d,"
+      "\"stream_bytes_per_s\":%.1f,\"stream_efficiency\":%.4f,"
+      "\"stream_errors\":%zu,"
+      "\"echo_p50_us\":%.1f,\"echo_p90_us\":%.1f,\"echo_p99_us\":%.1f,"
+      "\"echo_max_us\":%.1f,\"echo_lost\":%zu,\"burst\":[",
+      UART_BAUD_RATE, UART_CHAR_SIZE, UART_STOP_BITS,
+      parity_type_to_str(UART_PARITY), UART_RX_BUFFER_LEN, UART_TX_BUFFER_LEN,
+      res->stream_bytes_per_s, res->stream_efficiency, res->stream_errors,
+      bench_echo_percentile(res, 0.5), bench_echo_percentile(res, 0.9),
+      bench_echo_percentile(res, 0.99), bench_echo_percentile(res, 1),
+      BENCH_ECHO_ROUNDS - res->echo_count);
+
+  for (int k = 0; k < BENCH_BURST_LOADS; k++) {
+    fprintf(f,
+        "%s{\"load_us\":%u,\"sent\":%zu,\"received\":%zu,\"dropped\":%zu,"
+        "\"errors\":%zu}",
+        k ? "," : "", res->burst[k].load_us, res->burst[k].sent,
+        res->burst[k].received,
+        res->burst[k].sent - (res->burst[k].received < res->burst[k].sent ?
+          res->burst[k].received : res->burst[k].sent),
+        res->burst[k].errors);
+  }
+
+  fprintf(f, "]}\n");
+
+  if (f != stdout) {
+    fclose(f);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Run all benchmarks against the benchmark firmware
+ *
+ * @return 0 on success, -1 if the results could not be written
+ */
+int bench_run(int serdev) {
+
+  static struct bench_result res;
+
+  LOG(&log, LOGGER_INFO, "Running benchmark: stream");
+  bench_stream(serdev, &res);
+
+  LOG(&log, LOGGER_INFO, "Running benchmark: echo");
+  bench_echo(serdev, &res);
+
+  LOG(&log, LOGGER_INFO, "Running benchmark: burst");
+  bench_burst(serdev, &res);
+
+  return bench_write(&res);
+}
+
+#endif /* AVR_UART_BENCHMARK */
+
+/**
+ * @brief Run all UART tests against one board
+ *
+ * Orchestrates the tests:
  * - send_test: Verifies AVR can transmit
  * - recv_test: Verifies AVR can receive and echo
  * - partial_recv_test: Verifies partial data handling
+ * - timeout_recv_test: Verifies timed reception (if enabled)
+ * - desc_send_test: Verifies transmission of queued blocks (if enabled)
+ * - record_test: Verifies checked records in both directions (if enabled)
+ * - printf_test: Verifies the format parser (if enabled)
  * - match_test: Verifies pattern matching (if enabled)
  *
- * @param argc Argument count
- * @param argv Argument vector
- * @return 0 on success, non-zero on failure
+ * @param device     Path to the serial device of the board
+ * @param keep_going Run the remaining tests after a failure
+ * @return 0 on success, -1 on failure
  */
-int main(int argc, char *argv[]) {
+static int run_device(const char *device, int keep_going) {
 
   int serdev;
-  int keep_going, result;
+  int result;
   char buffer[BUFLEN];
-  struct sigaction old_sa;
-
-  logger_set_level(&log, LOGGER_ALL);
-  logger_set_function(&log, log_writer);
-
-  /* Copy default serial device path to buffer */
-  strncpy(buffer, SERDEV, BUFLEN);
 
-  if (parse_cmd_args(argc, argv, &keep_going, buffer, BUFLEN) == -1) {
-    return -1;
-  }
- 
-  if ( (serdev = open_serial_device(buffer)) == -1 ) {
+  if ( (serdev = open_serial_device(device)) == -1 ) {
     return -1;
   }
 
@@ -851,9 +1382,16 @@ int main(int argc, char *argv[]) {
   tcflush(serdev, TCIFLUSH);
 #endif
 
-  if (setup_alarm(&old_sa) == -1) {
-    return -1;
-  }
+#ifdef AVR_UART_BENCHMARK
+
+  /* The benchmark firmware runs no tests */
+  result = bench_run(serdev);
+
+  close(serdev);
+
+  return result;
+
+#endif /* AVR_UART_BENCHMARK */
 
   RUN_TEST(
       "send test",
@@ -894,6 +1432,66 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+#ifdef AVR_UART_TIMEOUT
+  RUN_TEST(
+      "timeout recv test",
+      result,
+      timeout_recv_test,
+      2,
+      serdev,
+      buffer
+    );
+
+  if (!keep_going && result) {
+    return -1;
+  }
+#endif /* AVR_UART_TIMEOUT */
+
+#ifdef AVR_UART_TX_DESC
+  RUN_TEST(
+      "desc send test",
+      result,
+      desc_send_test,
+      2,
+      serdev,
+      buffer
+    );
+
+  if (!keep_going && result) {
+    return -1;
+  }
+#endif /* AVR_UART_TX_DESC */
+
+#ifdef AVR_UART_RECORD
+  RUN_TEST(
+      "record test",
+      result,
+      record_test,
+      2,
+      serdev,
+      buffer
+    );
+
+  if (!keep_going && result) {
+    return -1;
+  }
+#endif /* AVR_UART_RECORD */
+
+#ifdef AVR_UART_PRINTF
+  RUN_TEST(
+      "printf test",
+      result,
+      printf_test,
+      2,
+      serdev,
+      buffer
+    );
+
+  if (!keep_going && result) {
+    return -1;
+  }
+#endif /* AVR_UART_PRINTF */
+
 #ifdef AVR_UART_MATCH
   int num_passed = 0;
   for (long unsigned int i = 0;
@@ -930,9 +1528,75 @@ int main(int argc, char *argv[]) {
     );
 #endif
 
-  cleanup_alarm(&old_sa);
-
   close(serdev);
 
   return 0;
 }
+
+/**
+ * @brief Main test driver entry point
+ *
+ * Runs the tests against each serial device given. Several devices are
+ * tested in parallel, one worker process per device.
+ *
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @return 0 on success, non-zero on failure
+ */
+int main(int argc, char *argv[]) {
+
+  int keep_going;
+  const char *devices[MAX_DEVICES];
+  int ndevices = 0;
+
+  logger_set_level(&log, LOGGER_ALL);
+  logger_set_function(&log, log_writer);
+
+  if (parse_cmd_args(argc, argv, &keep_going, devices, &ndevices) == -1) {
+    return -1;
+  }
+
+  if (ndevices == 0) {
+    devices[ndevices++] = SERDEV;
+  }
+
+  if (ndevices == 1) {
+    return run_device(devices[0], keep_going);
+  }
+
+  pid_t workers[MAX_DEVICES];
+
+  /* Messages of the workers interleave line by line */
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  for (int i = 0; i < ndevices; i++) {
+    workers[i] = fork();
+
+    if (workers[i] == 0) {
+      log_device = devices[i];
+      exit(run_device(devices[i], keep_going) ? EXIT_FAILURE : EXIT_SUCCESS);
+    } else if (workers[i] == -1) {
+      LOG(&log, LOGGER_ERROR, "Could not start worker for %s: %s",
+          devices[i], strerror(errno));
+    }
+  }
+
+  int failed = 0;
+
+  for (int i = 0; i < ndevices; i++) {
+    int status;
+
+    if (workers[i] == -1 || waitpid(workers[i], &status, 0) == -1 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      LOG(&log, LOGGER_ERROR, "Tests on %s failed", devices[i]);
+      failed++;
+    } else {
+      LOG(&log, LOGGER_INFO, "Tests on %s passed", devices[i]);
+    }
+  }
+
+  LOG(&log, LOGGER_INFO, "%d of %d devices passed", ndevices - failed,
+      ndevices);
+
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,804 @@
+/*
+ * avr-uart - UART module for AVR microcontrollers
+ * Copyright (C) 2026 notweerdmonk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/**
+ * @file uart_sim.c
+ * @author notweerdmonk
+ * @brief Cycle counting simavr harness with scripted UART input
+ *
+ * This program runs a firmware ELF in simavr one instruction at a time,
+ * feeds UART0 with the bytes of a script at the character rate the firmware
+ * programmed into UBRR0, UCSR0A and UCSR0C, and counts the CPU cycles spent
+ * in the ISRs and library functions of the firmware.
+ *
+ * Features:
+ * - Scripted RX byte streams with delays and waits for TX output
+ * - Calls, min, max, average and total cycles of each traced function,
+ *   from its first instruction to its return, and the part spent in ISRs
+ * - Receiver overruns, bytes arriving while two bytes are still unread
+ * - Plain text report or one JSON object per line
+ *
+ * Script commands, one per line, '#' starts a comment:
+ * - send "text"         Send the characters, C escapes are understood
+ * - hex 55 aa 00        Send the bytes given in hex
+ * - repeat n "text"     Send the characters n times
+ * - delay 10ms          Idle the RX line for a time in us, ms or c (cycles)
+ * - expect "text" 1s    Wait until the firmware has sent text or fail
+ *
+ * @note Requires simavr and libelf
+ *
+ * @code
+ * # Build the off-target firmware and the harness, then run the tests
+ * SIMTEST=1 MATCH=1 make
+ * make -C tests/sim
+ * ./tests/sim/uart_sim.elf -s tests/sim/target.script tests/target/main.elf
+ * @endcode
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+
+#include <libelf.h>
+#include <gelf.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_irq.h>
+#include <sim_io.h>
+#include <avr_uart.h>
+
+/**
+ * @brief Receive buffer depth of the USART, the third byte overruns
+ */
+#define UART_HW_RX_DEPTH 2
+
+/**
+ * @brief USART0 registers of the ATmega328P and the ATmega2560
+ */
+#define REG_UCSR0A 0xC0
+#define REG_UCSR0B 0xC1
+#define REG_UCSR0C 0xC2
+#define REG_UBRR0L 0xC4
+#define REG_UBRR0H 0xC5
+
+#define MAX_FUNCTIONS 128
+#define MAX_DEPTH     32
+#define MAX_PREFIXES  8
+#define OUTPUT_LEN    4096
+
+/**
+ * @brief Cycle counts of one traced function
+ */
+struct sim_function {
+  char name[64];
+  uint32_t addr;              /**< Byte address of the first instruction */
+  int isr;                    /**< Interrupt vector, counts towards ISRs */
+  uint64_t calls;
+  uint64_t min;
+  uint64_t max;
+  uint64_t total;
+  uint64_t in_isr;            /**< Part of total spent in ISRs */
+};
+
+/**
+ * @brief A traced function that has not yet returned
+ */
+struct sim_frame {
+  int func;
+  uint16_t sp;                /**< Stack pointer below the return address */
+  uint32_t ret;               /**< Byte address returned to */
+  avr_cycle_count_t start;
+  uint64_t isr_start;         /**< ISR cycles when the function started */
+};
+
+static struct sim_function functions[MAX_FUNCTIONS];
+static int num_functions;
+
+/* Function index for each flash word, -1 if none starts there */
+static int16_t *function_at;
+static uint32_t flash_words;
+
+static struct sim_frame frames[MAX_DEPTH];
+static int depth;
+
+static uint64_t isr_cycles;
+
+static const char *prefixes[MAX_PREFIXES] = { "__vector_", "avr_uart_" };
+static int num_prefixes = 2;
+
+/* TX bytes since the last expect */
+static char output[OUTPUT_LEN];
+static size_t output_len;
+
+static uint64_t tx_bytes;
+static uint64_t rx_bytes;
+static uint64_t overruns;
+
+static int verbose;
+
+static avr_t *avr;
+static avr_uart_t *uart;
+static avr_irq_t *uart_input;
+
+/**
+ * @brief Script being played
+ */
+static struct {
+  FILE *file;
+  int line;
+  uint8_t *bytes;             /**< Bytes of the current send */
+  size_t len;
+  size_t pos;
+  avr_cycle_count_t next;     /**< Cycle of the next byte or end of delay */
+  char expect[OUTPUT_LEN];
+  size_t expect_len;
+  avr_cycle_count_t deadline; /**< Cycle an expect fails at, 0 if none */
+  int done;
+  int failed;
+} script;
+
+/**
+ * @brief Convert a time with a us, ms, s or c suffix into cycles
+ *
+ * @return 0 on success, -1 on a malformed time
+ */
+static int parse_time(const char *s, avr_cycle_count_t *cycles) {
+
+  char *end;
+  double t = strtod(s, &end);
+
+  if (end == s || t < 0) {
+    return -1;
+  }
+
+  if (!strcmp(end, "c")) {
+    *cycles = t;
+  } else if (!strcmp(end, "us")) {
+    *cycles = t * avr->frequency / 1e6;
+  } else if (!strcmp(end, "ms")) {
+    *cycles = t * avr->frequency / 1e3;
+  } else if (!strcmp(end, "s") || !*end) {
+    *cycles = t * avr->frequency;
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Decode a quoted string with C escapes
+ *
+ * @return Number of bytes written to out, -1 on a malformed string
+ */
+static int parse_string(const char **s, uint8_t *out, size_t len) {
+
+  const char *p = *s;
+  size_t n = 0;
+
+  while (isspace((unsigned char)*p)) {
+    p++;
+  }
+  if (*p++ != '"') {
+    return -1;
+  }
+
+  while (*p && *p != '"' && n < len) {
+    char c = *p++;
+
+    if (c == '\\') {
+      switch (c = *p++) {
+        case 'r': c = '\r'; break;
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'e': c = 0x1b; break;
+        case '0': c = '\0'; break;
+        case 'x': {
+          char hex[3] = { 0 };
+          char *end;
+
+          strncpy(hex, p, 2);
+          c = strtol(hex, &end, 16);
+          if (end == hex) {
+            return -1;
+          }
+          p += end - hex;
+          break;
+        }
+        case '\0':
+          return -1;
+        default:
+          break;
+      }
+    }
+    out[n++] = c;
+  }
+
+  if (*p != '"') {
+    return -1;
+  }
+  *s = p + 1;
+
+  return n;
+}
+
+/**
+ * @brief CPU cycles of one character in the frame format of UART0
+ */
+static avr_cycle_count_t char_cycles(void) {
+
+  uint8_t a = avr->data[REG_UCSR0A];
+  uint8_t b = avr->data[REG_UCSR0B];
+  uint8_t c = avr->data[REG_UCSR0C];
+  uint16_t ubrr = (avr->data[REG_UBRR0H] << 8 | avr->data[REG_UBRR0L]) & 0xfff;
+  uint8_t ucsz = (c >> 1 & 0x3) | (b & 0x4);
+
+  /* Start bit, 5 to 9 data bits, parity and stop bits */
+  int bits = 1 + (ucsz == 7 ? 9 : 5 + ucsz) + ((c & 0x30) != 0) +
+    (c & 0x08 ? 2 : 1);
+
+  return (avr_cycle_count_t)(a & 0x02 ? 8 : 16) * (ubrr + 1) * bits;
+}
+
+/**
+ * @brief Read the next script command
+ *
+ * @return 0 when a command was started, -1 at the end or on an error
+ */
+static int script_next(void) {
+
+  char line[1024];
+
+  while (fgets(line, sizeof(line), script.file)) {
+    char *p = line;
+    char cmd[16];
+    int n;
+
+    script.line++;
+    line[strcspn(line, "#\r\n")] = '\0';
+
+    if (sscanf(p, "%15s%n", cmd, &n) != 1) {
+      continue;
+    }
+    p += n;
+
+    static uint8_t buf[1024];
+    const char *s = p;
+    int len = 0;
+
+    if (!strcmp(cmd, "send")) {
+      len = parse_string(&s, buf, sizeof(buf));
+
+    } else if (!strcmp(cmd, "hex")) {
+      unsigned int byte;
+
+      while (len < (int)sizeof(buf) && sscanf(s, "%x%n", &byte, &n) == 1) {
+        buf[len++] = byte;
+        s += n;
+      }
+
+    } else if (!strcmp(cmd, "repeat")) {
+      unsigned long count = strtoul(p, (char **)&s, 10);
+      uint8_t text[256];
+
+      len = parse_string(&s, text, sizeof(text));
+      if (len > 0) {
+        free(script.bytes);
+        script.bytes = malloc(count * len);
+        for (unsigned long i = 0; i < count; i++) {
+          memcpy(script.bytes + i * len, text, len);
+        }
+        script.len = count * len;
+        script.pos = 0;
+        return 0;
+      }
+
+    } else if (!strcmp(cmd, "delay")) {
+      char t[32];
+      avr_cycle_count_t cycles;
+
+      if (sscanf(p, "%31s", t) == 1 && !parse_time(t, &cycles)) {
+        if (script.next < avr->cycle) {
+          script.next = avr->cycle;
+        }
+        script.next += cycles;
+        return 0;
+      }
+      len = -1;
+
+    } else if (!strcmp(cmd, "expect")) {
+      char t[32] = "1s";
+      avr_cycle_count_t cycles;
+
+      len = parse_string(&s, (uint8_t *)script.expect,
+          sizeof(script.expect));
+      /* The timeout is optional */
+      sscanf(s, "%31s", t);
+      if (len >= 0 && !parse_time(t, &cycles)) {
+        script.expect_len = len;
+        script.deadline = avr->cycle + cycles;
+        return 0;
+      }
+      len = -1;
+
+    } else {
+      len = -1;
+    }
+
+    if (len < 0) {
+      fprintf(stderr, "Script line %d: invalid command\n", script.line);
+      script.failed = 1;
+      return -1;
+    }
+
+    free(script.bytes);
+    script.bytes = malloc(len);
+    memcpy(script.bytes, buf, len);
+    script.len = len;
+    script.pos = 0;
+    return 0;
+  }
+
+  return -1;
+}
+
+/**
+ * @brief Send a byte to UART0 unless the receiver would overrun
+ *
+ * simavr queues input without limit, so the harness drops a byte that
+ * arrives while the USART receive buffer is full and counts an overrun.
+ */
+static void uart_inject(uint8_t byte) {
+
+  rx_bytes++;
+
+  if (uart_fifo_get_read_size(&uart->input) >= UART_HW_RX_DEPTH) {
+    overruns++;
+    return;
+  }
+
+  avr_raise_irq(uart_input, byte);
+}
+
+/**
+ * @brief Advance the script to the current cycle
+ */
+static void script_step(void) {
+
+  while (!script.done) {
+
+    if (script.deadline) {
+      if (output_len >= script.expect_len &&
+          memmem(output, output_len, script.expect, script.expect_len)) {
+        script.deadline = 0;
+        output_len = 0;
+        if (script.next < avr->cycle) {
+          script.next = avr->cycle;
+        }
+      } else if (avr->cycle >= script.deadline) {
+        fprintf(stderr, "Script line %d: expected output not sent\n",
+            script.line);
+        script.failed = 1;
+        script.done = 1;
+      }
+      return;
+    }
+
+    if (avr->cycle < script.next) {
+      return;
+    }
+
+    if (script.pos < script.len) {
+      uart_inject(script.bytes[script.pos++]);
+      /* Back to back characters keep to the bit clock */
+      script.next += char_cycles();
+      return;
+    }
+
+    if (script_next()) {
+      script.done = 1;
+    }
+  }
+}
+
+static void uart_output(struct avr_irq_t *irq, uint32_t value, void *param) {
+
+  (void)irq;
+  (void)param;
+
+  tx_bytes++;
+
+  if (output_len == sizeof(output)) {
+    memmove(output, output + sizeof(output) / 2, sizeof(output) / 2);
+    output_len = sizeof(output) / 2;
+  }
+  output[output_len++] = value;
+
+  if (verbose) {
+    putchar(value);
+    fflush(stdout);
+  }
+}
+
+/**
+ * @brief Find the functions to trace in the symbol table of the firmware
+ *
+ * @return 0 on success, -1 if the ELF file cannot be read
+ */
+static int load_functions(const char *path) {
+
+  int fd = open(path, O_RDONLY);
+  Elf *e;
+  Elf_Scn *scn = NULL;
+
+  if (fd < 0 || elf_version(EV_CURRENT) == EV_NONE ||
+      !(e = elf_begin(fd, ELF_C_READ, NULL))) {
+    return -1;
+  }
+
+  while ((scn = elf_nextscn(e, scn))) {
+    GElf_Shdr shdr;
+
+    if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_SYMTAB) {
+      continue;
+    }
+
+    Elf_Data *data = elf_getdata(scn, NULL);
+
+    for (size_t i = 0; i < shdr.sh_size / shdr.sh_entsize; i++) {
+      GElf_Sym sym;
+      const char *name;
+
+      if (!gelf_getsym(data, i, &sym) ||
+          GELF_ST_TYPE(sym.st_info) != STT_FUNC ||
+          !(name = elf_strptr(e, shdr.sh_link, sym.st_name))) {
+        continue;
+      }
+
+      for (int k = 0; k < num_prefixes; k++) {
+        if (strncmp(name, prefixes[k], strlen(prefixes[k])) ||
+            num_functions == MAX_FUNCTIONS) {
+          continue;
+        }
+
+        struct sim_function *f = &functions[num_functions++];
+
+        snprintf(f->name, sizeof(f->name), "%s", name);
+        f->addr = sym.st_value;
+        f->isr = !strncmp(name, "__vector_", 9);
+        f->min = UINT64_MAX;
+        break;
+      }
+    }
+  }
+
+  elf_end(e);
+  close(fd);
+
+  return 0;
+}
+
+static inline uint16_t sim_sp(void) {
+  return avr->data[R_SPH] << 8 | avr->data[R_SPL];
+}
+
+/**
+ * @brief Open and close the frames of traced functions after a step
+ */
+static void trace_step(void) {
+
+  /* Returns, a tail call returns from its caller at the same time */
+  while (depth > 0 && avr->pc == frames[depth - 1].ret &&
+      sim_sp() == frames[depth - 1].sp + avr->address_size) {
+    struct sim_frame *fr = &frames[--depth];
+    struct sim_function *f = &functions[fr->func];
+    uint64_t cycles = avr->cycle - fr->start;
+
+    f->calls++;
+    f->total += cycles;
+    f->min = cycles < f->min ? cycles : f->min;
+    f->max = cycles > f->max ? cycles : f->max;
+
+    if (f->isr) {
+      isr_cycles += cycles;
+    } else {
+      f->in_isr += isr_cycles - fr->isr_start;
+    }
+  }
+
+  if (avr->pc / 2 >= flash_words || function_at[avr->pc / 2] < 0) {
+    return;
+  }
+
+  int func = function_at[avr->pc / 2];
+  uint16_t sp = sim_sp();
+
+  /* A loop back to the first instruction is not a call */
+  if ((depth > 0 && frames[depth - 1].func == func &&
+        frames[depth - 1].sp == sp) || depth == MAX_DEPTH) {
+    return;
+  }
+
+  /* The return address is stored high byte first above the stack pointer */
+  uint32_t ret = 0;
+
+  for (int i = 1; i <= avr->address_size; i++) {
+    ret = ret << 8 | avr->data[sp + i];
+  }
+
+  frames[depth++] = (struct sim_frame){
+    .func = func,
+    .sp = sp,
+    .ret = ret * 2,
+    .start = avr->cycle,
+    .isr_start = isr_cycles,
+  };
+}
+
+static int compare_functions(const void *a, const void *b) {
+
+  const struct sim_function *fa = a;
+  const struct sim_function *fb = b;
+
+  return fa->total < fb->total ? 1 : fa->total > fb->total ? -1 : 0;
+}
+
+static void report(const char *firmware, int json) {
+
+  qsort(functions, num_functions, sizeof(*functions), compare_functions);
+
+  if (json) {
+    printf("{\"firmware\":\"%s\",\"mmcu\":\"%s\",\"frequency\":%u,"
+        "\"cycles\":%llu,\"rx_bytes\":%llu,\"overruns\":%llu,"
+        "\"tx_bytes\":%llu,\"functions\":[",
+        firmware, avr->mmcu, avr->frequency,
+        (unsigned long long)avr->cycle, (unsigned long long)rx_bytes,
+        (unsigned long long)overruns, (unsigned long long)tx_bytes);
+
+    for (int i = 0, n = 0; i < num_functions; i++) {
+      struct sim_function *f = &functions[i];
+
+      if (!f->calls) {
+        continue;
+      }
+      printf("%s{\"name\":\"%s\",\"calls\":%llu,\"min\":%llu,\"max\":%llu,"
+          "\"total\":%llu,\"in_isr\":%llu}",
+          n++ ? "," : "", f->name, (unsigned long long)f->calls,
+          (unsigned long long)f->min, (unsigned long long)f->max,
+          (unsigned long long)f->total, (unsigned long long)f->in_isr);
+    }
+    printf("]}\n");
+    return;
+  }
+
+  printf("Firmware:  %s (%s, %u Hz)\n", firmware, avr->mmcu, avr->frequency);
+  printf("Cycles:    %llu (%.3f ms)\n", (unsigned long long)avr->cycle,
+      avr->cycle * 1e3 / avr->frequency);
+  printf("RX bytes:  %llu, overruns: %llu\n", (unsigned long long)rx_bytes,
+      (unsigned long long)overruns);
+  printf("TX bytes:  %llu\n\n", (unsigned long long)tx_bytes);
+
+  printf("%-32s %8s %8s %8s %10s %12s %12s\n",
+      "Function", "Calls", "Min", "Max", "Avg", "Total", "In ISRs");
+
+  for (int i = 0; i < num_functions; i++) {
+    struct sim_function *f = &functions[i];
+
+    if (!f->calls) {
+      continue;
+    }
+    printf("%-32s %8llu %8llu %8llu %10.1f %12llu %12llu\n",
+        f->name, (unsigned long long)f->calls, (unsigned long long)f->min,
+        (unsigned long long)f->max, (double)f->total / f->calls,
+        (unsigned long long)f->total, (unsigned long long)f->in_isr);
+  }
+}
+
+static void usage(const char *prog) {
+  printf("Usage: %s [OPTION] ... firmware.elf\n", prog);
+  printf("  -h             Display this message\n");
+  printf("  -s [script]    Play the script into UART0\n");
+  printf("  -m [mcu]       MCU if the firmware has no .mmcu section\n");
+  printf("  -f [hz]        CPU frequency if the firmware has none\n");
+  printf("  -p [prefix]    Also trace functions starting with prefix\n");
+  printf("  -t [time]      Run this long after the script (default: 10ms)\n");
+  printf("  -l [time]      Stop after this long in total (default: 60s)\n");
+  printf("  -j             Report as one JSON object\n");
+  printf("  -v             Print what the firmware sends\n");
+}
+
+/**
+ * @brief Run the firmware with the script and report the cycle counts
+ *
+ * @return 0 if the script ran to its end, 1 otherwise
+ */
+int main(int argc, char *argv[]) {
+
+  const char *script_path = NULL;
+  const char *mmcu = NULL;
+  const char *tail_time = "10ms";
+  const char *limit_time = "60s";
+  uint32_t frequency = 0;
+  int json = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, ":hs:m:f:p:t:l:jv")) != -1) {
+    switch (c) {
+      case 's':
+        script_path = optarg;
+        break;
+      case 'm':
+        mmcu = optarg;
+        break;
+      case 'f':
+        frequency = strtoul(optarg, NULL, 0);
+        break;
+      case 'p':
+        if (num_prefixes < MAX_PREFIXES) {
+          prefixes[num_prefixes++] = optarg;
+        }
+        break;
+      case 't':
+        tail_time = optarg;
+        break;
+      case 'l':
+        limit_time = optarg;
+        break;
+      case 'j':
+        json = 1;
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      case 'h':
+        usage(argv[0]);
+        return 1;
+      case ':':
+        fprintf(stderr, "Invalid option: %c requires an argument\n", optopt);
+        return 1;
+      default:
+        fprintf(stderr, "Invalid option: %c\n", optopt);
+        return 1;
+    }
+  }
+
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const char *firmware = argv[optind];
+  elf_firmware_t f;
+
+  memset(&f, 0, sizeof(f));
+
+  if (elf_read_firmware(firmware, &f) || load_functions(firmware)) {
+    fprintf(stderr, "Could not read firmware %s\n", firmware);
+    return 1;
+  }
+
+  if (mmcu) {
+    snprintf(f.mmcu, sizeof(f.mmcu), "%s", mmcu);
+  }
+  if (frequency) {
+    f.frequency = frequency;
+  }
+  if (!f.frequency) {
+    f.frequency = 16000000;
+  }
+
+  if (!f.mmcu[0] || !(avr = avr_make_mcu_by_name(f.mmcu))) {
+    fprintf(stderr, "Unknown MCU, give one with -m\n");
+    return 1;
+  }
+
+  avr_init(avr);
+  avr_load_firmware(avr, &f);
+
+  flash_words = (avr->flashend + 1) / 2;
+  function_at = malloc(flash_words * sizeof(*function_at));
+  memset(function_at, 0xff, flash_words * sizeof(*function_at));
+  for (int i = 0; i < num_functions; i++) {
+    if (functions[i].addr / 2 < flash_words) {
+      function_at[functions[i].addr / 2] = i;
+    }
+  }
+
+  for (avr_io_t *io = avr->io_port; io; io = io->next) {
+    if (!strcmp(io->kind, "uart") && ((avr_uart_t *)io)->name == '0') {
+      uart = (avr_uart_t *)io;
+    }
+  }
+  if (!uart) {
+    fprintf(stderr, "%s has no UART0\n", f.mmcu);
+    return 1;
+  }
+
+  /* The output goes to the expect buffer, not to simavr's stdout log */
+  uint32_t flags = 0;
+
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+  uart_input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+  avr_irq_register_notify(
+      avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+      uart_output, NULL);
+
+  avr_cycle_count_t tail;
+  avr_cycle_count_t limit;
+
+  if (parse_time(tail_time, &tail) || parse_time(limit_time, &limit)) {
+    fprintf(stderr, "Invalid time\n");
+    return 1;
+  }
+
+  if (script_path && !(script.file = fopen(script_path, "r"))) {
+    fprintf(stderr, "Could not open script %s\n", script_path);
+    return 1;
+  }
+  script.done = !script.file;
+
+  avr_cycle_count_t end = 0;
+  int state = cpu_Running;
+
+  while (state != cpu_Done && state != cpu_Crashed && avr->cycle < limit) {
+    state = avr_run(avr);
+    trace_step();
+
+    if (!script.done) {
+      script_step();
+    } else if (!script.file) {
+      /* Without a script the firmware runs until it is done */
+      continue;
+    } else if (!end) {
+      end = avr->cycle + tail;
+    } else if (avr->cycle >= end) {
+      break;
+    }
+  }
+
+  if (verbose) {
+    printf("\n");
+  }
+
+  report(firmware, json);
+
+  if (state == cpu_Crashed) {
+    fprintf(stderr, "Firmware crashed at pc 0x%04x\n", avr->pc);
+  } else if (!script.done) {
+    fprintf(stderr, "Script did not finish\n");
+  }
+
+  avr_terminate(avr);
+
+  return state == cpu_Crashed || !script.done || script.failed;
+}
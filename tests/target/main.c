@@ -36,6 +36,7 @@
  * - VCD trace generation for simulation
  *
  * @note Compile with MATCH=1 to enable pattern matching tests
+ * @note Compile with BENCHMARK=1 for the benchmark firmware
  */
 
 #include <config.h>
@@ -94,6 +95,18 @@ const struct avr_mmcu_vcd_trace_t _trace[] _MMCU_ = {
     AVR_MCU_VCD_SYMBOL("UDR0"),
     .what = (void*)&UDR0,
   },
+#ifdef AVR_UART_PROFILE_PINS
+  {
+    AVR_MCU_VCD_SYMBOL("RxISR"),
+    .mask = (1 << UART_PROFILE_RX_BIT),
+    .what = (void*)&UART_PROFILE_PORT,
+  },
+  {
+    AVR_MCU_VCD_SYMBOL("UdreISR"),
+    .mask = (1 << UART_PROFILE_UDRE_BIT),
+    .what = (void*)&UART_PROFILE_PORT,
+  },
+#endif /* AVR_UART_PROFILE_PINS */
 };
 
 #endif /* AVR_UART_SIMULATION || defined AVR_UART_SIMTEST */
@@ -131,6 +144,136 @@ void avr_uart_match_cb(void *data) {
 
 #endif /* AVR_UART_MATCH */
 
+#ifdef AVR_UART_BENCHMARK
+
+/**
+ * @brief Mask of the bits a character carries with UART_CHAR_SIZE
+ */
+#define BENCH_CHAR_MASK ((1 << UART_CHAR_SIZE) - 1)
+
+/**
+ * @brief Receive a decimal number terminated by any non digit
+ *
+ * @param end Stores the terminating character
+ * @return The number
+ */
+static uint32_t bench_recv_number(char *end) {
+
+  uint32_t n = 0;
+  char c;
+
+  while ((c = avr_uart_recv_byte()) >= '0' && c <= '9') {
+    n = n * 10 + (c - '0');
+  }
+  *end = c;
+
+  return n;
+}
+
+/**
+ * @brief Stream n bytes of a counting sequence as fast as the UART allows
+ */
+static void bench_stream(uint32_t n) {
+
+  char chunk[16];
+  uint8_t seq = 0;
+
+  while (n > 0) {
+    uint8_t len = n > sizeof(chunk) ? sizeof(chunk) : n;
+
+    for (uint8_t i = 0; i < len; i++) {
+      chunk[i] = seq++ & BENCH_CHAR_MASK;
+    }
+    avr_uart_send(chunk, len);
+    n -= len;
+  }
+}
+
+/**
+ * @brief Echo n bytes one at a time
+ */
+static void bench_echo(uint32_t n) {
+
+  while (n-- > 0) {
+    avr_uart_send_byte(avr_uart_recv_byte());
+  }
+}
+
+/**
+ * @brief Drain a burst of up to n bytes of a counting sequence
+ *
+ * Simulates an application that spends load_us after each byte. The burst
+ * ends with n bytes or 100 ms without a byte, then the number of bytes
+ * received and of bytes out of sequence is sent as "<received> <errors>".
+ */
+static void bench_burst(uint32_t n, uint16_t load_us) {
+
+  uint32_t received = 0;
+  uint32_t errors = 0;
+  uint16_t idle = 0;
+  uint8_t seq = 0;
+  char c;
+
+  while (received < n && idle < 1000) {
+    if (!avr_uart_try_recv(&c)) {
+      _delay_us(100);
+      idle++;
+      continue;
+    }
+
+    idle = 0;
+    if ((uint8_t)c != (seq & BENCH_CHAR_MASK)) {
+      errors++;
+      seq = c;
+    }
+    seq++;
+    received++;
+
+    for (uint16_t i = 0; i < load_us; i++) {
+      _delay_us(1);
+    }
+  }
+
+  avr_uart_send_uint32(received);
+  avr_uart_send_byte(' ');
+  avr_uart_send_uint32(errors);
+  avr_uart_newline();
+}
+
+/**
+ * @brief Benchmark command loop
+ *
+ * Commands are a letter, decimal arguments and a newline:
+ * - S<n>: stream n bytes of a counting sequence
+ * - E<n>: echo the next n bytes one at a time
+ * - B<n>,<load_us>: drain a burst of n bytes and report what arrived
+ */
+static void bench_loop(void) {
+
+  for (;;) {
+    char cmd = avr_uart_recv_byte();
+    char end;
+    uint32_t n = bench_recv_number(&end);
+    uint16_t load_us = end == ',' ? bench_recv_number(&end) : 0;
+
+    switch (cmd) {
+      case 'S':
+        bench_stream(n);
+        break;
+      case 'E':
+        bench_echo(n);
+        break;
+      case 'B':
+        bench_burst(n, load_us);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+#endif /* AVR_UART_BENCHMARK */
+
 const char pattern1[] = "UUUU"; /* Generates a square wave with 8N1 */
 const char pattern2[] = "AAAAAAAAAAAAAAAA";
 const char pattern3[] = "aaaaaaaaaaaaaaaa";
@@ -152,8 +295,14 @@ const char erstr[] = "recv ER";
  * - Sends test string to host
  * - Receives and verifies test string
  * - Tests partial reception
+ * - Tests reception with timeout (if enabled)
+ * - Sends queued RAM and flash blocks (if enabled)
+ * - Checks received records and sends one back (if enabled)
+ * - Sends formatted output (if enabled)
  * - Runs pattern matching tests (if enabled)
  *
+ * The benchmark firmware only runs the benchmark command loop.
+ *
  * @return 0 (never returns - infinite loop at end)
  */
 int main() {
@@ -181,6 +330,11 @@ int main() {
 
   sei();
 
+#ifdef AVR_UART_BENCHMARK
+  /* The benchmark firmware serves the host driver instead of the tests */
+  bench_loop();
+#endif
+
 #ifdef AVR_UART_EMIT_TRIGGER
 
   /* Wait a while */
@@ -213,7 +367,10 @@ int main() {
   /* Let the characters be send over UART by UDRE interrupt */
   _delay_us(us_per_byte * 53);
 
-  /* Simulation with simavr cannot facilitate sending input to UART */
+  /*
+   * SIM builds only transmit, SIMTEST builds get their input from the host
+   * driver through simduino or from a tests/sim script
+   */
 #if !defined AVR_UART_SIMULATION && !defined AVR_UART_DEMO
 
   size_t teststringlen = strlen(teststring);
@@ -247,6 +404,71 @@ int main() {
   /* Let the characters be send over UART by UDRE interrupt */
   _delay_us(10000);
 
+#ifdef AVR_UART_TIMEOUT
+
+  /* Consume the half left over by the partial reception test */
+  avr_uart_recv(buffer, teststringlen - teststringlen / 2);
+
+  /* Host sends only half the string, the rest must time out */
+  len = avr_uart_recv_timeout(buffer, teststringlen, 2000);
+  buffer[len] = '\0';
+
+  if (len == teststringlen / 2 &&
+      !strncmp(teststring, buffer, teststringlen / 2)) {
+    avr_uart_send(okstr, sizeof(okstr) - 1);
+  } else {
+    avr_uart_send(erstr, sizeof(erstr) - 1);
+  }
+
+  /* Let the characters be send over UART by UDRE interrupt */
+  _delay_us(10000);
+
+#endif /* AVR_UART_TIMEOUT */
+
+#ifdef AVR_UART_TX_DESC
+
+  /* Ring bytes, a RAM block and a flash block must leave in queue order */
+  avr_uart_send(okstr, 2);
+  avr_uart_send_desc(okstr + 2, 3, NULL, NULL);
+  avr_uart_pgm_send_desc(PSTR("OK"), 2, NULL, NULL);
+  avr_uart_flush_tx();
+
+#endif /* AVR_UART_TX_DESC */
+
+#ifdef AVR_UART_RECORD
+
+  /* Setting the length flushes RX, so the host waits to be told to send */
+  char record[8];
+  avr_uart_record_length(sizeof(record));
+  avr_uart_send(okstr, sizeof(okstr) - 1);
+
+  /* The host sends a good record and a copy with a flipped bit */
+  while (avr_uart_record_available() < 2);
+  uint8_t ok =
+    avr_uart_record_recv(record, sizeof(record)) == sizeof(record) &&
+    avr_uart_record_recv(buffer, sizeof(record)) == UART_RECORD_ERROR;
+  avr_uart_record_length(0);
+
+  /* The host checks the CRC of the record sent back */
+  avr_uart_record_begin();
+  avr_uart_record_bytes(record, sizeof(record));
+  avr_uart_record_end();
+  avr_uart_send(ok ? okstr : erstr, sizeof(okstr) - 1);
+  avr_uart_flush_tx();
+
+#endif /* AVR_UART_RECORD */
+
+#ifdef AVR_UART_PRINTF
+
+  /* Every conversion, flag and modifier, then a width past the clamp */
+  avr_uart_printf_P(PSTR("[%-5d|%05d|%x|%08lX|%.3s|%S|%c|%%|%.2f|%ld|%q]"),
+      -42, -7, 0xbeefu, 0x1234abcdUL, "abcdef", PSTR("flash"), 'z', 3.14159,
+      -100000L);
+  avr_uart_printf_P(PSTR("%300c"), '|');
+  avr_uart_flush_tx();
+
+#endif /* AVR_UART_PRINTF */
+
 #endif /* !AVR_UART_SIMULATION && !AVR_UART_DEMO */
 
 #if defined AVR_UART_MATCH && !defined AVR_UART_SIMULATION && !defined AVR_UART_DEMO